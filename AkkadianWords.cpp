@@ -1,12 +1,15 @@
 #include "common.h"
+#include <memory>
 #include <time.h>
 #include "dict.h"
 #include "handlers.h"
 #include "errors.h"
+#include "reload.h"
 #include "resource.h"
 
 #define MAX_LOADSTRING 100
 #define DICT_FILENAME _T("dict.dat")
+#define SNAPSHOT_FILENAME _T("dict.bin")
 
 HINSTANCE h_inst;                                // current instance
 WCHAR sz_title[MAX_LOADSTRING];                  // The title bar text
@@ -27,13 +30,16 @@ int APIENTRY wWinMain(
 	_In_ int n_cmd_show
 ) {
     UNREFERENCED_PARAMETER(h_prev_instance);
-    UNREFERENCED_PARAMETER(lp_cmd_line);
 
     time_t t;
     srand((unsigned int)time(&t));
 
+    // The stamp of the file that the dictionary was loaded from, so that the reloader can tell if it changed
+    FileStamp loaded_stamp;
+
     try {
-        Akk::dict = Dictionary(DICT_FILENAME);
+        Akk::dict.store(std::make_shared<const Dictionary>(Dictionary::load(DICT_FILENAME, SNAPSHOT_FILENAME, &loaded_stamp)));
+        log_unresolved(*Akk::dict.load());
     } catch (DictParseError err) {
         std::wstring msg = err.message();
 
@@ -52,6 +58,13 @@ int APIENTRY wWinMain(
         return -1;
     }
 
+    // With /reload, changes to the dictionary file are picked up while the program is running
+    std::unique_ptr<DictReloader> reloader;
+
+    if (wcsstr(lp_cmd_line, L"/reload")) {
+        reloader = std::make_unique<DictReloader>(DICT_FILENAME, SNAPSHOT_FILENAME, loaded_stamp);
+    }
+
     LoadStringW(h_instance, IDS_APP_TITLE, sz_title, MAX_LOADSTRING);
     LoadStringW(h_instance, IDC_AKKADIAN_WORDS, sz_window_class, MAX_LOADSTRING);
     MyRegisterClass(h_instance);
@@ -0,0 +1,93 @@
+#include "async_search.h"
+#include <string>
+#include "errors.h"
+
+AsyncSearch::AsyncSearch(SearchCache& cache, ThreadPool& pool) : cache(&cache), pool(&pool) {}
+
+AsyncSearch::~AsyncSearch() {
+	cancel();
+}
+
+std::future<std::shared_ptr<const Lookup>> AsyncSearch::start(
+	std::shared_ptr<const Dictionary> dict,
+	std::string_view query,
+	size_t limit,
+	int cutoff,
+	bool engl,
+	std::function<void()> on_done
+) {
+	// The task owns everything it uses, so it can outlive this object and the caller's query
+	SearchCache* cache = this->cache;
+	ThreadPool* pool = this->pool;
+
+	return run([=, query = std::string(query)](std::stop_token stop) {
+		return cache->lookup(dict, query, limit, cutoff, engl, pool, stop);
+	}, on_done);
+}
+
+std::future<std::shared_ptr<const Lookup>> AsyncSearch::start(
+	std::shared_ptr<SearchSession> session,
+	std::string_view query,
+	std::function<void()> on_done
+) {
+	std::shared_ptr<std::mutex> session_mutex = this->session_mutex;
+
+	return run([=, query = std::string(query)](std::stop_token stop) -> std::shared_ptr<const Lookup> {
+		std::lock_guard<std::mutex> lock(*session_mutex);
+
+		// A newer lookup could have been started while this one waited
+		if (stop.stop_requested()) {
+			throw SearchCancelled{};
+		}
+
+		const std::vector<std::string>& results = session->set_query(query, nullptr, stop);
+
+		return make_lookup(*session->get_dict(), results, session->get_engl(), stop);
+	}, on_done);
+}
+
+void AsyncSearch::cancel() {
+	std::lock_guard<std::mutex> lock(mutex);
+	current.request_stop();
+}
+
+/**
+ * Cancels the lookup in flight and runs a new one on the pool
+ */
+std::future<std::shared_ptr<const Lookup>> AsyncSearch::run(LookupTask lookup, std::function<void()> on_done) {
+	std::stop_source source{};
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		current.request_stop();
+		current = source;
+	}
+
+	std::stop_token stop = source.get_token();
+	std::shared_ptr<std::promise<std::shared_ptr<const Lookup>>> result =
+		std::make_shared<std::promise<std::shared_ptr<const Lookup>>>();
+	std::future<std::shared_ptr<const Lookup>> out = result->get_future();
+
+	pool->submit([=]() {
+		try {
+			// Lookups that were cancelled while they were queued don't start
+			if (stop.stop_requested()) {
+				throw SearchCancelled{};
+			}
+
+			result->set_value(lookup(stop));
+		} catch (const SearchCancelled&) {
+			result->set_exception(std::current_exception());
+			return;
+		} catch (...) {
+			// The caller still has to hear about a lookup that failed, so that it can show the error
+			result->set_exception(std::current_exception());
+		}
+
+		if (on_done) {
+			on_done();
+		}
+	});
+
+	return out;
+}
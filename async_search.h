@@ -0,0 +1,86 @@
+/**
+ * Lookups that run in the background, so that a slow search doesn't freeze the lookup dialogs.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string_view>
+#include "dict.h"
+#include "search_cache.h"
+#include "search_session.h"
+#include "thread_pool.h"
+
+/**
+ * Runs lookups through a cache on a thread pool, one at a time. Starting a lookup cancels the one before it, so a
+ * dialog can start a lookup for every change to the query and only the last one does all of its work. A cancelled
+ * lookup stops between shards of the search (see Dictionary::search) and its future throws SearchCancelled (see
+ * errors.h). A lookup that had already finished when it was cancelled keeps its results. Lookups can also come
+ * from a search-as-you-type session (see search_session.h), so that a keystroke doesn't search on the UI thread.
+ *
+ * Nothing here depends on the UI. A dialog gets its results by waiting on the future, or by having 'on_done' post
+ * a message to its window and reading the future when the message arrives.
+ */
+typedef struct AsyncSearch {
+	AsyncSearch(SearchCache& cache, ThreadPool& pool);
+
+	AsyncSearch(const AsyncSearch&) = delete;
+	AsyncSearch& operator=(const AsyncSearch&) = delete;
+
+	/**
+	 * Cancels the lookup in flight. It doesn't wait for it to stop; a running lookup only uses what it was
+	 * started with.
+	 */
+	~AsyncSearch();
+
+	/**
+	 * Cancels the lookup in flight and starts a new one on the pool. The arguments are the same as for
+	 * SearchCache::lookup. If 'on_done' isn't null, it's called on the worker thread once the future is ready,
+	 * either with the results or with the exception that the lookup failed with. It isn't called if the lookup
+	 * is cancelled.
+	 */
+	std::future<std::shared_ptr<const Lookup>> start(
+		std::shared_ptr<const Dictionary> dict,
+		std::string_view query,
+		size_t limit,
+		int cutoff,
+		bool engl,
+		std::function<void()> on_done = nullptr
+	);
+
+	/**
+	 * Same as start, but the results come from a session instead of the cache. The session is only searched
+	 * from one worker at a time, so it must only be used through this object once it's passed in. A lookup
+	 * that's cancelled while it waits for the session doesn't search it, and one that's cancelled while it
+	 * searches stops between chars of the query.
+	 */
+	std::future<std::shared_ptr<const Lookup>> start(
+		std::shared_ptr<SearchSession> session,
+		std::string_view query,
+		std::function<void()> on_done = nullptr
+	);
+
+	/**
+	 * Cancels the lookup in flight, if there is one
+	 */
+	void cancel();
+
+private:
+	typedef std::function<std::shared_ptr<const Lookup>(std::stop_token)> LookupTask;
+
+	SearchCache* cache{};
+	ThreadPool* pool{};
+	// Held by a lookup while it searches a session. This is shared with the lookups so that they can outlive
+	// this object.
+	std::shared_ptr<std::mutex> session_mutex{ std::make_shared<std::mutex>() };
+	std::mutex mutex{};
+	// Stops the last lookup that was started
+	std::stop_source current{ std::nostopstate };
+
+	std::future<std::shared_ptr<const Lookup>> run(LookupTask lookup, std::function<void()> on_done);
+} AsyncSearch;
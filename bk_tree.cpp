@@ -0,0 +1,164 @@
+#include "bk_tree.h"
+#include "edit_distance.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+
+void BKTree::build(const FoldedKeys& words) {
+	text.clear();
+	positions.resize(words.size());
+	nodes.clear();
+
+	std::iota(positions.begin(), positions.end(), 0);
+	std::stable_sort(positions.begin(), positions.end(), [&](uint32_t lhs, uint32_t rhs) {
+		return words[lhs] < words[rhs];
+	});
+
+	for (size_t i = 0; i < positions.size(); i++) {
+		std::u32string_view str = words[positions[i]];
+
+		if (!nodes.empty() && word(nodes.back()) == str) {
+			nodes.back().positions_end++;
+			continue;
+		}
+
+		Node node{};
+		node.text_begin = (uint32_t)text.size();
+		node.text_size = (uint32_t)str.size();
+		node.positions_begin = (uint32_t)i;
+		node.positions_end = (uint32_t)i + 1;
+
+		text += str;
+		nodes.push_back(node);
+	}
+
+	// Adding the words in alphabetical order makes long chains of similar words, so they're shuffled first.
+	// The seed is fixed so that the tree is the same every time.
+	std::mt19937 rng(0);
+	std::shuffle(nodes.begin(), nodes.end(), rng);
+
+	for (uint32_t i = 1; i < nodes.size(); i++) {
+		const LevPattern pattern(word(nodes[i]));
+		uint32_t parent = 0;
+
+		while (true) {
+			const uint32_t dist = (uint32_t)pattern.distance(word(nodes[parent]));
+			uint32_t child = nodes[parent].first_child;
+
+			while (child != NONE && nodes[child].dist != dist) {
+				child = nodes[child].next_sibling;
+			}
+
+			if (child == NONE) {
+				nodes[i].dist = dist;
+				nodes[i].next_sibling = nodes[parent].first_child;
+				nodes[parent].first_child = i;
+				break;
+			}
+
+			parent = child;
+		}
+	}
+}
+
+void BKTree::find(std::u32string_view str, int radius, std::vector<uint32_t>& out, size_t& cells) const {
+	if (nodes.empty()) {
+		return;
+	}
+
+	const LevPattern pattern(str);
+	std::vector<uint32_t> stack = { 0 };
+
+	while (!stack.empty()) {
+		const uint32_t node = stack.back();
+		stack.pop_back();
+
+		visit(pattern, radius, node, stack, out, cells);
+	}
+}
+
+void BKTree::find(
+	std::u32string_view str,
+	int radius,
+	std::vector<uint32_t>& out,
+	size_t& cells,
+	ThreadPool& pool,
+	std::stop_token stop
+) const {
+	if (nodes.empty()) {
+		return;
+	}
+
+	const LevPattern pattern(str);
+	const size_t min_subtrees = (pool.size() + 1) * SUBTREES_PER_THREAD;
+	std::vector<uint32_t> subtrees = { 0 };
+
+	// The top of the tree is searched one level at a time until there are enough subtrees to go around
+	while (!subtrees.empty() && subtrees.size() < min_subtrees) {
+		std::vector<uint32_t> next;
+
+		for (uint32_t node : subtrees) {
+			visit(pattern, radius, node, next, out, cells);
+		}
+
+		subtrees = std::move(next);
+	}
+
+	std::vector<std::vector<uint32_t>> subtree_outs(subtrees.size());
+	std::vector<size_t> subtree_cells(subtrees.size());
+
+	pool.for_each(subtrees.size(), [&](size_t i) {
+		std::vector<uint32_t> stack = { subtrees[i] };
+
+		while (!stack.empty() && !stop.stop_requested()) {
+			const uint32_t node = stack.back();
+			stack.pop_back();
+
+			visit(pattern, radius, node, stack, subtree_outs[i], subtree_cells[i]);
+		}
+	});
+
+	for (size_t i = 0; i < subtrees.size(); i++) {
+		out.insert(out.end(), subtree_outs[i].begin(), subtree_outs[i].end());
+		cells += subtree_cells[i];
+	}
+}
+
+size_t BKTree::size() const {
+	return nodes.size();
+}
+
+/**
+ * Checks one node against the query. If it's within the radius, its positions are appended to 'out', and the
+ * children that could have words within the radius are appended to 'next'.
+ */
+void BKTree::visit(
+	const LevPattern& pattern,
+	int radius,
+	uint32_t node_index,
+	std::vector<uint32_t>& next,
+	std::vector<uint32_t>& out,
+	size_t& cells
+) const {
+	const Node& node = nodes[node_index];
+	const int dist = pattern.distance(word(node));
+	cells += pattern.size() * node.text_size;
+
+	if (dist <= radius) {
+		out.insert(out.end(), positions.begin() + node.positions_begin, positions.begin() + node.positions_end);
+	}
+
+	// Everything under a child is exactly child.dist away from this node, so by the triangle inequality
+	// it's at least |dist - child.dist| away from the query
+	for (uint32_t child = node.first_child; child != NONE; child = nodes[child].next_sibling) {
+		if (std::abs(dist - (int)nodes[child].dist) <= radius) {
+			next.push_back(child);
+		}
+	}
+}
+
+std::u32string_view BKTree::word(const Node& node) const {
+	return std::u32string_view(text).substr(node.text_begin, node.text_size);
+}
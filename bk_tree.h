@@ -0,0 +1,91 @@
+/**
+ * Metric tree for fuzzy lookup of dictionary keys.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <cstdint>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "edit_distance.h"
+#include "letters.h"
+
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * A BK-tree over a list of words, using Levenshtein distance (see edit_distance.h). Each child of a node is
+ * labeled with its distance from the node, and because the distance obeys the triangle inequality, a search with
+ * a given radius only has to go into the children whose label is within the radius of the query's distance to
+ * the node. Words that are the same share a node. The tree is built once and then only read, so it can be
+ * searched from any number of threads at once.
+ *
+ * The tree compares characters exactly. It's built from folded keys (see letters.h), so the distance ignores
+ * diacritical marks.
+ */
+typedef struct BKTree {
+	/**
+	 * Builds the tree for a list of folded keys. Any previous contents are replaced.
+	 */
+	void build(const FoldedKeys& words);
+
+	/**
+	 * Finds the words that are at most 'radius' away from 'word' and appends their positions in the list
+	 * the tree was built from to 'out'. Positions are appended in no particular order. The number of edit distance
+	 * table cells computed is added to 'cells'.
+	 */
+	void find(std::u32string_view word, int radius, std::vector<uint32_t>& out, size_t& cells) const;
+
+	/**
+	 * Same as find, but the top of the tree is searched first to split the rest into subtrees that are searched
+	 * on a thread pool. If a stop is requested on 'stop', the subtrees stop being searched and only some of the
+	 * words are found.
+	 */
+	void find(
+		std::u32string_view word,
+		int radius,
+		std::vector<uint32_t>& out,
+		size_t& cells,
+		ThreadPool& pool,
+		std::stop_token stop = {}
+	) const;
+
+	/**
+	 * Returns the number of distinct words in the tree
+	 */
+	size_t size() const;
+
+private:
+	static const uint32_t NONE = UINT32_MAX;
+	static const size_t SUBTREES_PER_THREAD = 8;
+
+	typedef struct Node {
+		// The word is text[text_begin, text_begin + text_size)
+		uint32_t text_begin{};
+		uint32_t text_size{};
+		// The positions of the word are positions[positions_begin, positions_end)
+		uint32_t positions_begin{};
+		uint32_t positions_end{};
+		uint32_t first_child{ NONE };
+		uint32_t next_sibling{ NONE };
+		// Distance from the parent
+		uint32_t dist{};
+	} Node;
+
+	std::u32string text{};
+	std::vector<uint32_t> positions{};
+	// nodes[0] is the root
+	std::vector<Node> nodes{};
+
+	std::u32string_view word(const Node& node) const;
+	void visit(
+		const LevPattern& pattern,
+		int radius,
+		uint32_t node_index,
+		std::vector<uint32_t>& next,
+		std::vector<uint32_t>& out,
+		size_t& cells
+	) const;
+} BKTree;
@@ -3,25 +3,14 @@
 #include <vector>
 #include <CommCtrl.h>
 #include "components.h"
-
-const static std::vector<std::vector<wchar_t>> char_cycle_map = {
-    {L's', L'š', L'ṣ'},
-    {L't', L'ṭ'},
-    {L'a', L'ā', L'â'},
-    {L'e', L'ē', L'ê'},
-    {L'i', L'ī', L'î'},
-    {L'u', L'ū', L'û'},
-    {L'h', L'ḫ'}
-};
+#include "letters.h"
 
 static wchar_t next_char(wchar_t c) {
-    for (size_t i = 0; i < char_cycle_map.size(); i++) {
-        size_t len = char_cycle_map[i].size();
+    for (std::u32string_view group : LETTER_GROUPS) {
+        size_t pos = group.find((char32_t)c);
 
-        for (size_t j = 0; j < len; j++) {
-            if (char_cycle_map[i][j] == c) {
-                return char_cycle_map[i][(j + 1) % len];
-            }
+        if (pos != std::u32string_view::npos) {
+            return (wchar_t)group[(pos + 1) % group.size()];
         }
     }
 
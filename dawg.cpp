@@ -0,0 +1,229 @@
+#include "dawg.h"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+void Dawg::build(const FoldedKeys& words) {
+	states.clear();
+	arcs.clear();
+	max_size = 0;
+	positions.resize(words.size());
+	rank_ends.clear();
+
+	std::iota(positions.begin(), positions.end(), 0);
+	std::stable_sort(positions.begin(), positions.end(), [&](uint32_t lhs, uint32_t rhs) {
+		return words[lhs] < words[rhs];
+	});
+
+	// Words are added in sorted order (Daciuk et al., "Incremental construction of minimal acyclic finite-state
+	// automata", 2000). Only the path of the last word is open; when the next word leaves that path, the states
+	// that are left behind can't change anymore, so they're closed and merged with any identical state.
+	std::unordered_map<std::u32string, uint32_t> registry;
+	std::vector<OpenState> path(1);
+	std::u32string_view prev;
+
+	for (uint32_t i = 0; i < (uint32_t)positions.size(); i++) {
+		std::u32string_view word = words[positions[i]];
+
+		if (!rank_ends.empty() && word == prev) {
+			rank_ends.back() = i + 1;
+			continue;
+		}
+
+		rank_ends.push_back(i + 1);
+		max_size = (std::max)(max_size, word.size());
+
+		const size_t common = std::mismatch(prev.begin(), prev.end(), word.begin(), word.end()).first - prev.begin();
+
+		while (path.size() > common + 1) {
+			const uint32_t state = close_state(path.back(), registry);
+
+			path.pop_back();
+			path.back().arcs.back().target = state;
+		}
+
+		for (size_t j = common; j < word.size(); j++) {
+			path.back().arcs.push_back(Arc{ word[j] });
+			path.push_back(OpenState{});
+		}
+
+		path.back().final = true;
+		prev = word;
+	}
+
+	while (path.size() > 1) {
+		const uint32_t state = close_state(path.back(), registry);
+
+		path.pop_back();
+		path.back().arcs.back().target = state;
+	}
+
+	root = close_state(path.back(), registry);
+	states.shrink_to_fit();
+	arcs.shrink_to_fit();
+}
+
+void Dawg::find(std::u32string_view query, int cutoff, TopScores& top, size_t& cells) const {
+	find(query, cutoff, 0, (uint32_t)num_words(), top, cells);
+}
+
+void Dawg::find(
+	std::u32string_view query,
+	int cutoff,
+	uint32_t rank_begin,
+	uint32_t rank_end,
+	TopScores& top,
+	size_t& cells
+) const {
+	if (states.empty() || top.max_score() < 0 || rank_begin >= rank_end) {
+		return;
+	}
+
+	const size_t row_size = query.size() + 1;
+
+	Walk walk{};
+	walk.query = query;
+	walk.cutoff = cutoff;
+	walk.rank_begin = rank_begin;
+	walk.rank_end = rank_end;
+	walk.rows.resize((max_size + 2) * row_size);
+	walk.top = &top;
+	walk.cells = &cells;
+
+	std::iota(walk.rows.begin(), walk.rows.begin() + row_size, 0);
+
+	visit(walk, root, 0, 0, 0);
+}
+
+size_t Dawg::num_words() const {
+	return states.empty() ? 0 : states[root].words;
+}
+
+size_t Dawg::graph_size() const {
+	return states.size() * sizeof(State) + arcs.size() * sizeof(Arc);
+}
+
+/**
+ * Returns the state that an open state is the same as, adding it if there isn't one yet. Two states are the same
+ * if they're both final or both not, and have the same arcs to the same states.
+ */
+uint32_t Dawg::close_state(OpenState& state, std::unordered_map<std::u32string, uint32_t>& registry) {
+	std::u32string key(1, state.final ? 1 : 0);
+
+	for (const Arc& arc : state.arcs) {
+		key.push_back(arc.label);
+		key.push_back((char32_t)arc.target);
+	}
+
+	auto it = registry.find(key);
+
+	if (it != registry.end()) {
+		return it->second;
+	}
+
+	State out{};
+	out.arcs_begin = (uint32_t)arcs.size();
+	out.arcs_end = (uint32_t)(arcs.size() + state.arcs.size());
+	out.words = state.final ? 1 : 0;
+	out.final = state.final;
+
+	for (const Arc& arc : state.arcs) {
+		out.words += states[arc.target].words;
+	}
+
+	arcs.insert(arcs.end(), state.arcs.begin(), state.arcs.end());
+	states.push_back(out);
+
+	const uint32_t id = (uint32_t)states.size() - 1;
+	registry.emplace(std::move(key), id);
+
+	return id;
+}
+
+/**
+ * Visits a state that is 'depth' chars from the root. Row 'depth' of the edit distance table is already filled
+ * in, 'mismatches' is the Hamming distance between the query and the chars so far (only the first query.size()
+ * chars count), and 'rank' is the rank of the first word that can be reached from the state.
+ *
+ * Only the band of each row within 'limit' of the diagonal is filled in, where 'limit' is the highest score that
+ * could still be kept. Cells outside the band are more than 'limit' anyway, and the cell just past the end of the
+ * band is set to limit + 1 so that the next row can read it. The limit only goes down during the walk, so a row
+ * filled in with an older limit has a band at least as wide as the next row needs.
+ */
+void Dawg::visit(Walk& walk, uint32_t state, size_t depth, int mismatches, uint32_t rank) const {
+	const State& node = states[state];
+	const std::u32string_view query = walk.query;
+	const size_t row_size = query.size() + 1;
+	const int* row = walk.rows.data() + depth * row_size;
+
+	if (node.final) {
+		const int limit = (std::min)(walk.cutoff, walk.top->max_score());
+		// The last cell is only filled in if it's in the band
+		int score = std::abs((int)query.size() - (int)depth) <= limit ? row[query.size()] : limit + 1;
+
+		// Prioritize substitutions at the start of the word
+		if (depth >= query.size()) {
+			score = (std::min)(score, mismatches);
+		}
+
+		if (score <= limit && rank >= walk.rank_begin) {
+			const uint32_t begin = rank == 0 ? 0 : rank_ends[rank - 1];
+
+			for (uint32_t i = begin; i < rank_ends[rank]; i++) {
+				walk.top->add(score, positions[i]);
+			}
+		}
+
+		rank++;
+	}
+
+	int* next = walk.rows.data() + (depth + 1) * row_size;
+
+	for (uint32_t i = node.arcs_begin; i < node.arcs_end && rank < walk.rank_end; i++) {
+		const Arc& arc = arcs[i];
+
+		// The words past this arc are ranked [rank, rank + words)
+		if (rank + states[arc.target].words <= walk.rank_begin) {
+			rank += states[arc.target].words;
+			continue;
+		}
+
+		const int limit = (std::min)(walk.cutoff, walk.top->max_score());
+		const int over = limit + 1;
+		const int next_mismatches = depth < query.size() && query[depth] != arc.label ? mismatches + 1 : mismatches;
+		const int diag = (int)depth + 1;
+		const int lo = (std::max)(0, diag - limit);
+		const int hi = (std::min)((int)query.size(), diag + limit);
+		int row_min = over;
+
+		if (lo == 0) {
+			next[0] = (std::min)(row[0] + 1, over);
+			row_min = next[0];
+		}
+		else if (lo <= hi) {
+			next[lo - 1] = over;
+		}
+
+		for (int j = (std::max)(lo, 1); j <= hi; j++) {
+			const int cost = query[j - 1] == arc.label ? 0 : 1;
+
+			next[j] = (std::min)({ row[j] + 1, next[j - 1] + 1, row[j - 1] + cost, over });
+			row_min = (std::min)(row_min, next[j]);
+		}
+
+		if (hi + 1 < (int)row_size) {
+			next[hi + 1] = over;
+		}
+
+		if (lo <= hi) {
+			*walk.cells += hi - lo + 1;
+		}
+
+		// Nothing past this arc can be kept if both distances are already too far
+		if (row_min <= limit || next_mismatches <= limit) {
+			visit(walk, arc.target, depth + 1, next_mismatches, rank);
+		}
+
+		rank += states[arc.target].words;
+	}
+}
@@ -0,0 +1,116 @@
+/**
+ * Minimal automaton of the dictionary keys, for fuzzy lookup.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "edit_distance.h"
+#include "letters.h"
+
+/**
+ * A directed acyclic word graph: the minimal deterministic automaton that accepts exactly the (distinct) words of
+ * a list of folded keys. It's a trie where every set of identical subtrees is stored once, so common endings like
+ * "-um" and "-tum" are shared and the graph is much smaller than the trie. Each state also stores how many words
+ * can be reached from it, which gives every word its rank in sorted order without storing the word.
+ *
+ * The fuzzy search walks the graph in lockstep with a Levenshtein automaton for the query: the state of the
+ * Levenshtein automaton is a row of the edit distance table, and following an edge advances it by one char.
+ * Any branch where every entry in the row is over the cutoff (and the Hamming distance of the first chars is
+ * too) can't lead to a match, so it isn't followed. Once enough matches are found, the cutoff drops to the score
+ * of the worst of them, and only the cells of each row that are within the cutoff of the diagonal are computed.
+ *
+ * The graph is built once and then only read, so it can be searched from any number of threads at once.
+ */
+typedef struct Dawg {
+	/**
+	 * Builds the graph for a list of folded keys. Any previous contents are replaced.
+	 */
+	void build(const FoldedKeys& words);
+
+	/**
+	 * Scores every word the same way as the fuzzy search in search.cpp: the Levenshtein distance from 'query',
+	 * or if the word is at least as long as the query, the lower of that and the Hamming distance between the query
+	 * and the start of the word. For each word that scores at most 'cutoff', adds the score to 'top' for every
+	 * position in the list the graph was built from that has that word. The number of edit distance table cells
+	 * computed is added to 'cells'.
+	 */
+	void find(std::u32string_view query, int cutoff, TopScores& top, size_t& cells) const;
+
+	/**
+	 * Same as find, but only for the words with rank in [rank_begin, rank_end), where words are ranked from 0 in
+	 * sorted order. Branches with no words in the range aren't followed, so a search can be split into ranges
+	 * that are searched in parallel.
+	 */
+	void find(
+		std::u32string_view query,
+		int cutoff,
+		uint32_t rank_begin,
+		uint32_t rank_end,
+		TopScores& top,
+		size_t& cells
+	) const;
+
+	/**
+	 * Returns the number of distinct words in the graph
+	 */
+	size_t num_words() const;
+
+	/**
+	 * Returns the number of bytes used by the states and edges
+	 */
+	size_t graph_size() const;
+
+private:
+	static const uint32_t NONE = UINT32_MAX;
+
+	typedef struct Arc {
+		char32_t label{};
+		uint32_t target{ NONE };
+	} Arc;
+
+	typedef struct State {
+		// The state's arcs are arcs[arcs_begin, arcs_end), sorted by label
+		uint32_t arcs_begin{};
+		uint32_t arcs_end{};
+		// Number of words that can be reached from this state, counting the empty word if it's final
+		uint32_t words{};
+		bool final{};
+	} State;
+
+	// A state on the path of the last word added while building. Its last arc doesn't have a target until
+	// the state it leads to is finished.
+	typedef struct OpenState {
+		std::vector<Arc> arcs{};
+		bool final{};
+	} OpenState;
+
+	typedef struct Walk {
+		std::u32string_view query{};
+		int cutoff{};
+		// Row 'depth' of the edit distance table is rows[depth * (query.size() + 1)...]
+		std::vector<int> rows{};
+		uint32_t rank_begin{};
+		uint32_t rank_end{};
+		TopScores* top{};
+		size_t* cells{};
+	} Walk;
+
+	std::vector<State> states{};
+	std::vector<Arc> arcs{};
+	uint32_t root{};
+	size_t max_size{};
+
+	// The positions that have the word with rank r are positions[rank_ends[r - 1], rank_ends[r])
+	std::vector<uint32_t> positions{};
+	std::vector<uint32_t> rank_ends{};
+
+	uint32_t close_state(OpenState& state, std::unordered_map<std::u32string, uint32_t>& registry);
+	void visit(Walk& walk, uint32_t state, size_t depth, int mismatches, uint32_t rank) const;
+} Dawg;
@@ -1,17 +1,31 @@
 ﻿#include "common.h"
 #include <algorithm>
 #include <assert.h>
+#include <cstdint>
 #include <cstdlib>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <set>
-#include <sstream>
+#include <stdexcept>
+#include <string_view>
 #include <tuple>
+#include <unordered_set>
 #include <vector>
 #include "dict.h"
 #include "errors.h"
+#include "thread_pool.h"
 
-Dictionary Akk::dict;
+// Files smaller than twice this size are parsed on the calling thread
+const size_t MIN_LOAD_CHUNK_SIZE = 64 * 1024;
+// More chunks than threads helps balance the load when some chunks take longer than others
+const size_t LOAD_CHUNKS_PER_THREAD = 4;
+// Scratch memory on the stack for merging the entries of one English word. Words with more entries than fit
+// here spill over to the heap.
+const size_t ENGL_KEY_SCRATCH_SIZE = 16 * 1024;
+
+std::atomic<std::shared_ptr<const Dictionary>> Akk::dict;
 
 static bool file_exists(std::wstring& filename) {
 	DWORD dwAttrib = GetFileAttributesW(filename.c_str());
@@ -25,142 +39,401 @@ static size_t file_size(std::wstring& filename) {
 	return fileinfo.st_size;
 }
 
-static std::vector<std::wstring> split_str(std::wstring& str, wchar_t delim) {
-	std::vector<std::wstring> out;
-	std::wstringstream stream(str);
+/**
+ * Splits a string on a delimiter without copying anything. Tokens are produced the same way as repeated
+ * calls to std::getline: an empty string has no tokens, and a delimiter at the very end of the string does
+ * not produce an empty token.
+ */
+typedef struct Tokenizer {
+	std::string_view rest;
+	char delim;
+
+	Tokenizer(std::string_view str, char delim) : rest(str), delim(delim) {}
+
+	bool next(std::string_view& token) {
+		if (rest.empty()) {
+			return false;
+		}
+
+		size_t pos = rest.find(delim);
 
-	for (std::wstring token; std::getline(stream, token, delim);) {
-		out.push_back(token);
+		if (pos == std::string_view::npos) {
+			token = rest;
+			rest = std::string_view();
+		} else {
+			token = rest.substr(0, pos);
+			rest = rest.substr(pos + 1);
+		}
+
+		return true;
 	}
+} Tokenizer;
 
-	return out;
-}
+/**
+ * A fixed hash table for looking up one of a small set of keywords (grammar kinds, word classes, or
+ * relations). The table is built at compile time, and a lookup is a hash and usually one comparison.
+ */
+template <size_t N>
+struct KeywordTable {
+	static const size_t NUM_SLOTS = 32;
+
+	static_assert(N < NUM_SLOTS, "Keyword table is too small");
+
+	std::string_view keys[NUM_SLOTS]{};
+	int values[NUM_SLOTS]{};
+
+	constexpr KeywordTable(const std::string_view (&keywords)[N]) {
+		for (size_t i = 0; i < NUM_SLOTS; i++) {
+			values[i] = -1;
+		}
+
+		for (size_t i = 0; i < N; i++) {
+			size_t slot = hash(keywords[i]);
+
+			while (values[slot] != -1) {
+				slot = (slot + 1) % NUM_SLOTS;
+			}
+
+			keys[slot] = keywords[i];
+			values[slot] = (int)i;
+		}
+	}
+
+	static constexpr size_t hash(std::string_view str) {
+		uint32_t hash = 2166136261u;
+
+		for (char c : str) {
+			hash = (hash ^ (unsigned char)c) * 16777619u;
+		}
+
+		return hash % NUM_SLOTS;
+	}
+
+	/**
+	 * Returns the index of the keyword, or -1 if the string is not a keyword.
+	 */
+	int find(std::string_view str) const {
+		for (size_t slot = hash(str); values[slot] != -1; slot = (slot + 1) % NUM_SLOTS) {
+			if (keys[slot] == str) {
+				return values[slot];
+			}
+		}
+
+		return -1;
+	}
+};
 
-static std::pair<std::vector<WordClass>, std::vector<WordRelation>> parse_word_attrs(std::wstring& str, int line_num) {
-	std::vector<std::wstring> tokens = split_str(str, ';');
-	std::vector<WordClass> words;
-	std::vector<WordRelation> rels;
+constexpr KeywordTable<NUM_GRAMMAR_KINDS> grammar_kind_table(GRAMMAR_KINDS);
+constexpr KeywordTable<NUM_WORD_CLASSES> word_class_table(WORD_CLASSES);
+constexpr KeywordTable<NUM_RELATIONS> relation_table(RELATIONS);
 
-	for (size_t i = 0; i < tokens.size(); i++) {
-		std::wstring& token = tokens[i];
+static void parse_word_attrs(
+	std::string_view str,
+	int line_num,
+	WordClassMask& classes,
+	std::vector<WordRelation>& rels
+) {
+	Tokenizer tokens(str, ';');
+
+	for (std::string_view token; tokens.next(token);) {
 		size_t lpos = token.find('(');
 
-		if (lpos == std::wstring::npos) {
-			for (size_t j = 0; j < NUM_WORD_CLASSES; j++) {
-				if (token == WORD_CLASSES[j]) {
-					words.push_back((WordClass)j);
-					goto cont;
-				}
+		if (lpos == std::string_view::npos) {
+			int word_class = word_class_table.find(token);
+
+			if (word_class == -1) {
+				throw DictParseError(line_num, ParseErrorType::UnknownWordClass);
 			}
 
-			throw DictParseError(line_num, ParseErrorType::UnknownWordClass);
+			classes |= word_class_bit((WordClass)word_class);
 		} else {
 			size_t rpos = token.find(')');
 
-			if (rpos == std::wstring::npos) {
+			if (rpos == std::string_view::npos) {
 				throw DictParseError(line_num, ParseErrorType::MissingRightParen);
 			}
 
-			std::wstring rel_name = token.substr(0, lpos);
-			WordRelationKind rel_kind;
+			int rel_kind = relation_table.find(token.substr(0, lpos));
 
-			for (size_t j = 0; j < NUM_RELATIONS; j++) {
-				if (rel_name == RELATIONS[j]) {
-					rel_kind = (WordRelationKind)j;
-					goto found_rel;
-				}
+			if (rel_kind == -1) {
+				throw DictParseError(line_num, ParseErrorType::UnknownRelation);
 			}
 
-			throw DictParseError(line_num, ParseErrorType::UnknownRelation);
-		found_rel:
-
-			std::wstring word = token.substr(lpos + 1, rpos - lpos - 1);
-			rels.push_back(WordRelation(rel_kind, word));
+			rels.push_back(WordRelation((WordRelationKind)rel_kind, Akk::symbols.intern(token.substr(lpos + 1, rpos - lpos - 1))));
 		}
-	cont:;
+	}
+}
+
+static GrammarKind get_grammar_kind(std::string_view str, int line_num) {
+	int grammar_kind = grammar_kind_table.find(str);
+
+	if (grammar_kind == -1) {
+		throw DictParseError(line_num, ParseErrorType::UnknownGrammarKind);
+	}
+
+	return (GrammarKind)grammar_kind;
+}
+
+std::string read_dict_file(std::wstring& filename) {
+	if (!file_exists(filename)) {
+		throw DictParseError(0, ParseErrorType::FileNotFound);
+	}
+
+	FILE* fp;
+	errno_t code = _wfopen_s(&fp, filename.c_str(), L"rb");
+
+	if (code) {
+		throw DictParseError(0, ParseErrorType::UnknownError);
+	}
+
+	std::string buf;
+	buf.resize(file_size(filename));
+	buf.resize(fread(buf.data(), 1, buf.size(), fp));
+	fclose(fp);
+
+	const std::string_view utf8_bom = "\xEF\xBB\xBF";
+
+	if (std::string_view(buf).starts_with(utf8_bom)) {
+		buf.erase(0, utf8_bom.size());
 	}
 
-	return std::pair<std::vector<WordClass>, std::vector<WordRelation>>(words, rels);
+	return buf;
 }
 
-static GrammarKind get_grammar_kind(std::wstring& str, int line_num) {
-	for (size_t i = 0; i < NUM_GRAMMAR_KINDS; i++) {
-		if (str == GRAMMAR_KINDS[i]) {
-			return (GrammarKind)i;
+ParsedLine parse_dict_line(std::string_view line, int line_num) {
+	// The file used to be read in text mode, which turned \r\n into \n
+	if (line.ends_with('\r')) {
+		line.remove_suffix(1);
+	}
+
+	Tokenizer field_tokens(line, ',');
+	std::string_view fields[4];
+	size_t num_fields = 0;
+
+	for (std::string_view field; field_tokens.next(field); num_fields++) {
+		if (num_fields == std::size(fields)) {
+			throw DictParseError(line_num, ParseErrorType::TooManyFields);
 		}
+
+		fields[num_fields] = field;
+	}
+
+	// Word class field is optional
+	if (num_fields < 3) {
+		throw DictParseError(line_num, ParseErrorType::MissingWord);
 	}
 
-	throw DictParseError(line_num, ParseErrorType::UnknownGrammarKind);
+	ParsedLine out;
+	out.akk_word = Akk::symbols.intern(fields[0]);
+
+	Tokenizer engl_tokens(fields[1], ';');
+
+	for (std::string_view engl; engl_tokens.next(engl);) {
+		out.engl_words.push_back(Akk::symbols.intern(engl));
+	}
+
+	out.grammar_kind = get_grammar_kind(fields[2], line_num);
+
+	if (num_fields > 3) {
+		parse_word_attrs(fields[3], line_num, out.word_classes, out.rels);
+		out.has_attrs = true;
+	}
+
+	return out;
 }
 
-template <typename T>
-static std::vector<T> dedup(std::vector<T>& vec) {
-	std::set<T> deduped(vec.begin(), vec.end());
-	std::vector<T> out;
-	out.assign(deduped.begin(), deduped.end());
+std::vector<std::string_view> split_dict_lines(std::string_view text) {
+	std::vector<std::string_view> out;
+	Tokenizer lines(text, '\n');
+
+	for (std::string_view line; lines.next(line);) {
+		out.push_back(line);
+	}
 
 	return out;
 }
 
-WordRelation::WordRelation(WordRelationKind kind, std::wstring word) : kind(kind), word(word) {}
+/**
+ * Parses a chunk of the dictionary file. Line numbers in errors are relative to the start of the chunk.
+ */
+static std::vector<ParsedLine> parse_chunk(std::string_view chunk) {
+	std::vector<ParsedLine> out;
+	Tokenizer lines(chunk, '\n');
 
-bool WordRelation::operator<(const WordRelation& rhs) const {
-	return kind < rhs.kind;
+	for (std::string_view line; lines.next(line);) {
+		out.push_back(parse_dict_line(line, (int)out.size() + 1));
+	}
+
+	return out;
 }
 
-DictEntry::DictEntry(
-	const std::vector<WordClass> word_types,
-	const std::vector<std::wstring> defns,
-	GrammarKind grammar_kind,
-	std::vector<WordRelation> relations
-) : 
-	word_types(word_types), defns(defns), grammar_kind(grammar_kind), relations(relations) {
-	std::sort(this->word_types.begin(), this->word_types.end());
-	std::sort(this->relations.begin(), this->relations.end());
+/**
+ * Splits the dictionary file into chunks that end on line boundaries. Tokenizing each chunk separately
+ * gives the same lines as tokenizing the whole file.
+ */
+static std::vector<std::string_view> split_chunks(std::string_view text, size_t num_chunks) {
+	std::vector<std::string_view> out;
+	size_t chunk_size = text.size() / num_chunks + 1;
+
+	while (!text.empty()) {
+		size_t end = text.find('\n', chunk_size - 1);
+		end = end == std::string_view::npos ? text.size() : end + 1;
+
+		out.push_back(text.substr(0, end));
+		text.remove_prefix(end);
+	}
+
+	return out;
 }
 
-void DictEntry::add_relation(WordRelation rel) {
-	for (size_t i = 0; i < relations.size(); i++) {
-		WordRelation& r = relations[i];
+std::vector<ParsedLine> parse_dict_text(std::string_view text) {
+	// Large files are parsed in chunks on the thread pool. Chunks are joined in order, so the result
+	// is exactly the same as if the file had been parsed on one thread.
+	ThreadPool& pool = ThreadPool::shared();
+	size_t num_chunks = 1;
+
+	if (text.size() >= 2 * MIN_LOAD_CHUNK_SIZE) {
+		num_chunks = (std::min)(pool.size() * LOAD_CHUNKS_PER_THREAD, text.size() / MIN_LOAD_CHUNK_SIZE);
+	}
+
+	if (num_chunks == 1) {
+		return parse_chunk(text);
+	}
+
+	std::vector<std::string_view> chunks = split_chunks(text, num_chunks);
+	std::vector<std::future<std::vector<ParsedLine>>> parsed_chunks;
+	std::vector<ParsedLine> out;
 
-		if (r.kind == rel.kind && r.word == rel.word) {
-			return;
+	// Reserved so that a future is never lost between submitting its chunk and storing it
+	parsed_chunks.reserve(chunks.size());
+
+	try {
+		for (std::string_view chunk : chunks) {
+			parsed_chunks.push_back(pool.submit([chunk]() { return parse_chunk(chunk); }));
 		}
+
+		for (size_t i = 0; i < parsed_chunks.size(); i++) {
+			std::vector<ParsedLine> lines;
+
+			try {
+				lines = parsed_chunks[i].get();
+			} catch (DictParseError err) {
+				throw DictParseError((int)out.size() + err.line, err.err_type);
+			}
+
+			out.insert(out.end(), std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+		}
+	} catch (...) {
+		// The chunks that haven't been joined are still reading from the text, which the caller may free as
+		// soon as this returns
+		for (std::future<std::vector<ParsedLine>>& parsed : parsed_chunks) {
+			if (parsed.valid()) {
+				parsed.wait();
+			}
+		}
+
+		throw;
 	}
 
-	relations.push_back(rel);
+	return out;
+}
+
+/**
+ * Sorts the items and removes items that are equivalent to an earlier one. Of the equivalent items, the one
+ * that came first is kept.
+ */
+template <typename T, typename Alloc>
+static void dedup(std::vector<T, Alloc>& vec) {
+	std::stable_sort(vec.begin(), vec.end());
+	vec.erase(std::unique(vec.begin(), vec.end(), [](const T& lhs, const T& rhs) {
+		return !(lhs < rhs) && !(rhs < lhs);
+	}), vec.end());
 }
 
-bool DictEntry::has_word_classes(std::vector<WordClass> classes) const {
-	return std::all_of(classes.begin(), classes.end(), [this](WordClass c) {
-		return std::find(word_types.begin(), word_types.end(), c) != word_types.end();
+/**
+ * Removes duplicate symbols and sorts the rest alphabetically.
+ */
+template <typename Alloc>
+static void dedup_symbols(std::vector<Symbol, Alloc>& vec) {
+	std::sort(vec.begin(), vec.end());
+	vec.erase(std::unique(vec.begin(), vec.end()), vec.end());
+	std::sort(vec.begin(), vec.end(), [](Symbol lhs, Symbol rhs) {
+		return Akk::symbols.less(lhs, rhs);
 	});
 }
 
-std::wstring DictEntry::akk_summary(std::wstring& word) const {
-	std::wstring out = word + L" (" + GRAMMAR_KINDS[grammar_kind];
+/**
+ * Appends a list of symbols to a string, separated by commas.
+ */
+static void append_list(std::string& out, std::span<const Symbol> syms) {
+	for (size_t i = 0; i < syms.size() - 1; i++) {
+		out += Akk::symbols.str(syms[i]);
+		out += ", ";
+	}
 
-	if (word_types.size() > 0) {
-		out += L"; ";
+	out += Akk::symbols.str(syms[syms.size() - 1]);
+}
 
-		for (size_t i = 0; i < word_types.size() - 1; i++) {
-			out += WORD_CLASSES[word_types[i]] + L", ";
+WordRelation::WordRelation(WordRelationKind kind, Symbol word) : kind(kind), word(word) {}
+
+bool WordRelation::operator<(const WordRelation& rhs) const {
+	return kind < rhs.kind;
+}
+
+/**
+ * Appends the word classes in a mask to a summary. Nothing is appended if the mask is empty.
+ */
+static void append_word_classes(std::string& out, WordClassMask classes) {
+	bool first = true;
+
+	for (size_t i = 0; i < NUM_WORD_CLASSES; i++) {
+		if (!(classes & word_class_bit((WordClass)i))) {
+			continue;
 		}
 
-		out += WORD_CLASSES[word_types[word_types.size() - 1]];
+		out += first ? "; " : ", ";
+		out += WORD_CLASSES[i];
+		first = false;
 	}
+}
 
-	out += L"):\r\n";
+std::span<const Symbol> DictEntry::defns() const {
+	return std::span<const Symbol>(pool->defns.data() + defns_begin, num_defns);
+}
 
-	for (size_t i = 0; i < defns.size() - 1; i++) {
-		out += defns[i] + L", ";
+std::span<const WordRelation> DictEntry::relations() const {
+	return std::span<const WordRelation>(pool->relations.data() + relations_begin, num_relations);
+}
+
+std::vector<WordClass> DictEntry::word_types() const {
+	std::vector<WordClass> out;
+
+	for (size_t i = 0; i < NUM_WORD_CLASSES; i++) {
+		if (word_classes & word_class_bit((WordClass)i)) {
+			out.push_back((WordClass)i);
+		}
 	}
 
-	out += defns[defns.size() - 1] + L"\r\n";
+	return out;
+}
+
+bool DictEntry::has_word_classes(WordClassMask classes) const {
+	return (word_classes & classes) == classes;
+}
+
+std::string DictEntry::akk_summary(std::string_view word) const {
+	std::string out(word);
+	out += " (";
+	out += GRAMMAR_KINDS[grammar_kind];
+	append_word_classes(out, word_classes);
 
-	std::vector<std::wstring> buckets[NUM_FULL_RELATIONS];
+	out += "):\r\n";
+	append_list(out, defns());
+	out += "\r\n";
 
-	for (const WordRelation& rel : relations) {
+	std::vector<Symbol> buckets[NUM_FULL_RELATIONS];
+
+	for (const WordRelation& rel : relations()) {
 		buckets[rel.kind].push_back(rel.word);
 	}
 
@@ -169,379 +442,752 @@ std::wstring DictEntry::akk_summary(std::wstring& word) const {
 			continue;
 		}
 
-		out += RELATION_NAMES[i] + L": ";
+		out += RELATION_NAMES[i];
+		out += ": ";
+		append_list(out, buckets[i]);
+		out += "\r\n";
+	}
 
-		for (size_t j = 0; j < buckets[i].size() - 1; j++) {
-			out += buckets[i][j] + L", ";
-		}
+	return out;
+}
 
-		out += buckets[i][buckets[i].size() - 1] + L"\r\n";
-	}
+std::string DictEntry::engl_summary(std::string_view word) const {
+	std::string out(word);
+	out += " (";
+	out += GRAMMAR_KINDS[grammar_kind];
+	append_word_classes(out, word_classes);
+
+	out += "):\r\n";
+	append_list(out, defns());
+	out += "\r\n";
 
 	return out;
 }
 
-std::wstring DictEntry::engl_summary(std::wstring& word) const {
-	std::wstring out = word + L" (" + GRAMMAR_KINDS[grammar_kind];
+/**
+ * A dictionary entry that is still being built. Relations are added while the dictionary is loaded, and then
+ * the finished entries are packed into an EntryPool. Builders only live while a dictionary is being built, so
+ * their vectors come from the scratch memory of the build.
+ */
+typedef struct EntryBuilder {
+	WordClassMask word_classes{};
+	GrammarKind grammar_kind{};
+	std::pmr::vector<Symbol> defns{};
+	std::pmr::vector<WordRelation> relations{};
+	// The kind and word of every relation, so that add_relation doesn't scan 'relations'. This is only filled in
+	// once a relation is added.
+	std::pmr::unordered_set<uint64_t> relation_keys{};
+
+	EntryBuilder(
+		WordClassMask word_classes,
+		std::pmr::vector<Symbol> defns,
+		GrammarKind grammar_kind,
+		std::pmr::vector<WordRelation> relations
+	);
+
+	/**
+	 * Unpacks an entry so that it can be changed
+	 */
+	EntryBuilder(const DictEntry& entry, std::pmr::memory_resource* scratch);
+
+	void add_relation(WordRelation rel);
+} EntryBuilder;
+
+EntryBuilder::EntryBuilder(
+	WordClassMask word_classes,
+	std::pmr::vector<Symbol> defns,
+	GrammarKind grammar_kind,
+	std::pmr::vector<WordRelation> relations
+) :
+	word_classes(word_classes), grammar_kind(grammar_kind), defns(std::move(defns)), relations(std::move(relations)),
+	relation_keys(this->relations.get_allocator()) {
+	std::sort(this->relations.begin(), this->relations.end());
+}
+
+EntryBuilder::EntryBuilder(const DictEntry& entry, std::pmr::memory_resource* scratch) :
+	word_classes(entry.word_classes), grammar_kind(entry.grammar_kind), defns(scratch), relations(scratch),
+	relation_keys(scratch) {
+	std::span<const Symbol> entry_defns = entry.defns();
+	std::span<const WordRelation> entry_relations = entry.relations();
 
-	if (word_types.size() > 0) {
-		out += L"; ";
+	defns.assign(entry_defns.begin(), entry_defns.end());
+	relations.assign(entry_relations.begin(), entry_relations.end());
+}
 
-		for (size_t i = 0; i < word_types.size() - 1; i++) {
-			out += WORD_CLASSES[word_types[i]] + L", ";
+static uint64_t relation_key(const WordRelation& rel) {
+	return ((uint64_t)rel.kind << 32) | rel.word;
+}
+
+/**
+ * Adds a relation to the end, unless the entry already has it. A word that many entries point to gets an inverse
+ * relation from each of them, so the relations are looked up in a set instead of scanned.
+ */
+void EntryBuilder::add_relation(WordRelation rel) {
+	if (relation_keys.empty()) {
+		for (const WordRelation& r : relations) {
+			relation_keys.insert(relation_key(r));
 		}
+	}
+
+	if (relation_keys.insert(relation_key(rel)).second) {
+		relations.push_back(rel);
+	}
+}
 
-		out += WORD_CLASSES[word_types[word_types.size() - 1]];
+// Stands for the part of speech of the word that has the relation
+const int SAME_GRAMMAR_KIND = -1;
+
+/**
+ * A part of speech and word classes that the target of a relation can have
+ */
+typedef struct RelationTargetFilter {
+	int grammar_kind;
+	WordClassMask word_classes;
+} RelationTargetFilter;
+
+/**
+ * How a relation in the dictionary file is resolved. The target word must have an entry that matches
+ * one of the filters, which are tried in order, and the inverse relation is added to the first entry that
+ * matches.
+ */
+typedef struct RelationRule {
+	WordRelationKind inverse;
+	size_t num_filters;
+	RelationTargetFilter filters[2];
+	const char* error;
+} RelationRule;
+
+// One rule for each relation that can be written in the file, in the order of RELATIONS
+const RelationRule RELATION_RULES[] = {
+	{ WordRelationKind::HasPreterite, 1, { { GrammarKind::Verb, word_class_bit(WordClass::Infinitive) } },
+		"Unknown infinitive mapped by preterite" },
+	{ WordRelationKind::HasVerbalAdj, 1, { { GrammarKind::Verb, word_class_bit(WordClass::Infinitive) } },
+		"Unknown infinitive mapped by verbal adj" },
+	{ WordRelationKind::HasSubst, 1, { { GrammarKind::Adjective, 0 } },
+		"Unknown adjective mapped by substantivized noun" },
+	{ WordRelationKind::HasBoundForm, 2, { { SAME_GRAMMAR_KIND, 0 }, { GrammarKind::Verb, word_class_bit(WordClass::Infinitive) } },
+		"Unknown n/adj/v mapped by bound form" },
+	{ WordRelationKind::HasGenitive, 1, { { SAME_GRAMMAR_KIND, word_class_bit(WordClass::Nominative) } },
+		"Unknown n/adj mapped by genitive case" },
+	{ WordRelationKind::HasAccusative, 1, { { SAME_GRAMMAR_KIND, word_class_bit(WordClass::Nominative) } },
+		"Unknown n/adj mapped by accusative case" },
+	{ WordRelationKind::HasDative, 1, { { SAME_GRAMMAR_KIND, word_class_bit(WordClass::Nominative) } },
+		"Unknown n/adj/pr mapped by dative case" },
+	// The base of a word is only shown with the word
+	{ WordRelationKind::Base, 0, {}, nullptr }
+};
+
+static_assert(sizeof RELATION_RULES / sizeof * RELATION_RULES == NUM_RELATIONS, "Every relation needs a rule");
+
+/**
+ * An Akkadian word with a part of speech and word classes that a relation can target
+ */
+typedef struct RelationTarget {
+	Symbol word;
+	GrammarKind grammar_kind;
+	WordClassMask word_classes;
+
+	bool operator==(const RelationTarget& other) const = default;
+} RelationTarget;
+
+typedef struct RelationTargetHash {
+	size_t operator()(const RelationTarget& target) const {
+		return std::hash<uint64_t>()(((uint64_t)target.word << 24) | ((uint64_t)target.grammar_kind << 16) | target.word_classes);
 	}
+} RelationTargetHash;
+
+typedef std::pmr::unordered_map<RelationTarget, EntryBuilder*, RelationTargetHash> RelationTargetIndex;
 
-	out += L"):\r\n";
+/**
+ * Indexes the first entry of each Akkadian word that matches each of the word class filters used by
+ * RELATION_RULES. This finds the same entry as scanning the word's entries for the first match.
+ */
+static RelationTargetIndex index_relation_targets(EntryBuilderMap& akk_entries) {
+	std::vector<WordClassMask> masks;
 
-	for (size_t i = 0; i < defns.size() - 1; i++) {
-		out += defns[i] + L", ";
+	for (const RelationRule& rule : RELATION_RULES) {
+		for (size_t i = 0; i < rule.num_filters; i++) {
+			if (std::find(masks.begin(), masks.end(), rule.filters[i].word_classes) == masks.end()) {
+				masks.push_back(rule.filters[i].word_classes);
+			}
+		}
 	}
 
-	out += defns[defns.size() - 1] + L"\r\n";
+	// The index is only used while the dictionary is being built, so it uses the same scratch memory as the entries
+	RelationTargetIndex out(akk_entries.get_allocator());
+	out.reserve(akk_entries.size() * masks.size());
+
+	for (auto& [word, entries] : akk_entries) {
+		for (EntryBuilder& entry : entries) {
+			for (WordClassMask mask : masks) {
+				if ((entry.word_classes & mask) == mask) {
+					out.emplace(RelationTarget{ word, entry.grammar_kind, mask }, &entry);
+				}
+			}
+		}
+	}
 
 	return out;
 }
 
-DictEntry DictEntry::merge(DictEntry& other) const {
-	std::vector<std::wstring> new_defns(this->defns);
-	std::vector<WordRelation> new_relations(this->relations);
+/**
+ * Adds the inverse of every relation in 'source' to the entry that it targets, in the order that the
+ * relations appear. Relations that can't be resolved are added to 'unresolved'. If 'targets' is given,
+ * only relations that target one of those words are added, and the rest are only checked.
+ */
+static void resolve_relations(
+	EntryBuilderMap& akk_entries,
+	const EnglDict& source,
+	const std::set<Symbol>* targets,
+	std::vector<UnresolvedRelation>& unresolved
+) {
+	RelationTargetIndex index = index_relation_targets(akk_entries);
+
+	for (size_t i = 0; i < source.line_words.size(); i++) {
+		const DictEntry& line = source.lines.entries[i];
+		const Symbol akk_word = source.line_words[i];
+
+		for (const WordRelation& rel : line.relations()) {
+			const RelationRule& rule = RELATION_RULES[rel.kind];
+
+			if (!rule.num_filters) {
+				continue;
+			}
+
+			EntryBuilder* entry = nullptr;
 
-	new_defns.insert(new_defns.end(), other.defns.begin(), other.defns.end());
-	new_relations.insert(new_relations.end(), other.relations.begin(), other.relations.end());
+			for (size_t j = 0; j < rule.num_filters && !entry; j++) {
+				const RelationTargetFilter& filter = rule.filters[j];
+				GrammarKind kind = filter.grammar_kind == SAME_GRAMMAR_KIND ? line.grammar_kind : (GrammarKind)filter.grammar_kind;
+				auto it = index.find(RelationTarget{ rel.word, kind, filter.word_classes });
+
+				if (it != index.end()) {
+					entry = it->second;
+				}
+			}
 
-	return DictEntry(word_types, dedup(new_defns), grammar_kind, dedup(new_relations));
+			if (!entry) {
+				unresolved.push_back(UnresolvedRelation{ (int)i + 1, akk_word, rel.kind, rel.word });
+			} else if (!targets || targets->count(rel.word)) {
+				entry->add_relation(WordRelation(rule.inverse, akk_word));
+			}
+		}
+	}
 }
 
-bool DictEntry::can_merge(DictEntry& other) const {
-	return grammar_kind == other.grammar_kind && word_types == other.word_types;
+std::string UnresolvedRelation::message() const {
+	return "Line " + std::to_string(line) + ": " + RELATION_RULES[kind].error + ": " + std::string(Akk::symbols.str(target));
 }
 
-Dictionary::Dictionary(std::wstring filename) {
-	if (!file_exists(filename)) {
-		throw DictParseError(0, ParseErrorType::FileNotFound);
+/**
+ * Copies an entry's definitions and relations to the end of the pool
+ */
+static DictEntry pack_entry(
+	EntryPool& pool,
+	WordClassMask word_classes,
+	GrammarKind grammar_kind,
+	std::span<const Symbol> defns,
+	std::span<const WordRelation> relations
+) {
+	if (defns.size() > UINT16_MAX || relations.size() > UINT16_MAX) {
+		throw std::length_error("Too many definitions or relations in one dictionary entry");
 	}
 
-	std::wstring buf;
-	FILE* fp;
-	errno_t code = _wfopen_s(&fp, filename.c_str(), L"rt, ccs=UTF-8");
+	DictEntry out;
+	out.pool = &pool;
+	out.defns_begin = (uint32_t)pool.defns.size();
+	out.relations_begin = (uint32_t)pool.relations.size();
+	out.num_defns = (uint16_t)defns.size();
+	out.num_relations = (uint16_t)relations.size();
+	out.word_classes = word_classes;
+	out.grammar_kind = grammar_kind;
 
-	if (code) {
-		throw DictParseError(0, ParseErrorType::UnknownError);
+	pool.defns.insert(pool.defns.end(), defns.begin(), defns.end());
+	pool.relations.insert(pool.relations.end(), relations.begin(), relations.end());
+
+	return out;
+}
+
+/**
+ * Packs built entries into a pool. Keys are sorted by text, so that the order doesn't depend on the order
+ * the symbols were interned.
+ */
+static void pack_entries(
+	EntryPool& pool,
+	const EntryBuilderMap& built,
+	std::vector<Symbol>& keys,
+	std::vector<uint32_t>& offsets,
+	KeyIndex& index
+) {
+	size_t num_entries = 0;
+	size_t num_defns = 0;
+	size_t num_relations = 0;
+
+	for (const auto& [_, key_entries] : built) {
+		num_entries += key_entries.size();
+
+		for (const EntryBuilder& entry : key_entries) {
+			num_defns += entry.defns.size();
+			num_relations += entry.relations.size();
+		}
 	}
 
-	size_t size = file_size(filename);
-	buf.resize(size);
-	size_t chars_read = fread(&(buf.front()), sizeof(wchar_t), size, fp);
-	buf.resize(chars_read);
-	buf.shrink_to_fit();
-	fclose(fp);
-	std::vector<std::wstring> lines = split_str(buf, '\n');
+	pool.entries.reserve(num_entries);
+	pool.defns.reserve(num_defns);
+	pool.relations.reserve(num_relations);
+	keys.reserve(built.size());
+	offsets.reserve(built.size() + 1);
 
-	std::random_device rd;
-	this->rng = std::mt19937(rd());
+	for (const auto& [key, _] : built) {
+		keys.push_back(key);
+	}
 
-	// Word relations are resolved after the entire dictionary has been read. This means that
-	// a PreteriteOf relation can be defined before the corresponding infinitive, or a 
-	// VerbalAdjOf before the infinitive, etc.
-	std::vector<std::tuple<std::wstring, GrammarKind, std::vector<WordRelation>>> unresolved_rels;
-	int line_num = 1;
+	std::sort(keys.begin(), keys.end(), [](Symbol lhs, Symbol rhs) {
+		return Akk::symbols.less(lhs, rhs);
+	});
 
-	for (std::wstring line : lines) {
-		std::vector<std::wstring> fields = split_str(line, ',');
+	for (Symbol key : keys) {
+		offsets.push_back((uint32_t)pool.entries.size());
 
-		// Word class field is optional
-		if (fields.size() < 3) {
-			throw DictParseError(line_num, ParseErrorType::MissingWord);
-		}
-		else if (fields.size() > 4) {
-			throw DictParseError(line_num, ParseErrorType::TooManyFields);
+		for (const EntryBuilder& entry : built.at(key)) {
+			pool.entries.push_back(pack_entry(pool, entry.word_classes, entry.grammar_kind, entry.defns, entry.relations));
 		}
+	}
+
+	offsets.push_back((uint32_t)pool.entries.size());
+	index.build(keys);
+}
 
-		std::wstring akk_word = fields[0];
-		std::vector<std::wstring> engl_words = split_str(fields[1], ';');
-		GrammarKind grammar_kind = get_grammar_kind(fields[2], line_num);
-		std::pair<std::vector<WordClass>, std::vector<WordRelation>> attrs;
+/**
+ * A key on one line of the dictionary file. For the Akk->Engl dictionary the key is the line's Akkadian word,
+ * and for the Engl->Akk dictionary it's one of the line's English words.
+ */
+typedef struct LinePosting {
+	Symbol key;
+	uint32_t line;
+} LinePosting;
+
+/**
+ * Sorts postings by key and then by line, and returns where each key's postings start
+ */
+static std::vector<size_t> sort_postings(std::vector<LinePosting>& postings) {
+	std::sort(postings.begin(), postings.end(), [](const LinePosting& lhs, const LinePosting& rhs) {
+		return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.line < rhs.line);
+	});
 
-		if (fields.size() > 3) {
-			attrs = parse_word_attrs(fields[3], line_num);
-			std::sort(attrs.first.begin(), attrs.first.end());
+	std::vector<size_t> starts;
 
-			unresolved_rels.push_back(std::tuple<std::wstring, GrammarKind, std::vector<WordRelation>>(akk_word, grammar_kind, attrs.second));
+	for (size_t i = 0; i < postings.size(); i++) {
+		if (i == 0 || postings[i].key != postings[i - 1].key) {
+			starts.push_back(i);
 		}
+	}
 
-		DictEntry akk_entry(attrs.first, engl_words, grammar_kind, attrs.second);
-		insert_akk(akk_word, akk_entry);
+	return starts;
+}
 
-		for (std::wstring engl : engl_words) {
-			DictEntry engl_entry(attrs.first, { akk_word }, grammar_kind, attrs.second);
-			insert_engl(engl, engl_entry);
+/**
+ * Groups the postings of the key that starts at 'start' by part of speech and word classes. The lines in a
+ * group become one entry. Groups are moved next to each other in the order that they first appear in the file,
+ * and the lines in each group stay in order. The end of each group is added to 'group_ends'.
+ */
+static void group_postings(const EnglDict& source, std::vector<LinePosting>& postings, size_t start, std::vector<size_t>& group_ends) {
+	typedef std::pair<GrammarKind, WordClassMask> GroupKey;
+
+	thread_local std::vector<GroupKey> keys;
+	keys.clear();
+	group_ends.clear();
+
+	auto group_of = [&](const LinePosting& posting) {
+		const DictEntry& line = source.lines.entries[posting.line];
+		return (size_t)(std::find(keys.begin(), keys.end(), GroupKey(line.grammar_kind, line.word_classes)) - keys.begin());
+	};
+
+	size_t end = start;
+
+	for (; end < postings.size() && postings[end].key == postings[start].key; end++) {
+		if (group_of(postings[end]) == keys.size()) {
+			const DictEntry& line = source.lines.entries[postings[end].line];
+			keys.push_back(GroupKey(line.grammar_kind, line.word_classes));
 		}
-
-		line_num++;
 	}
 
-	for (auto& [word, grammar_kind, rels] : unresolved_rels) {
-		resolve_relations(word, grammar_kind, rels);
+	// Most keys have only one group
+	if (keys.size() > 1) {
+		std::stable_sort(postings.begin() + start, postings.begin() + end, [&](const LinePosting& lhs, const LinePosting& rhs) {
+			return group_of(lhs) < group_of(rhs);
+		});
+
+		for (size_t i = start + 1; i < end; i++) {
+			if (group_of(postings[i]) != group_of(postings[i - 1])) {
+				group_ends.push_back(i);
+			}
+		}
 	}
 
-	std::sort(akk_keys.begin(), akk_keys.end());
-	std::sort(engl_keys.begin(), engl_keys.end());
+	group_ends.push_back(end);
+}
 
-	std::string debug_msg = "Read " + std::to_string(line_num - 1) + " lines\n";
-	debug_msg += "Akk entries: " + std::to_string(akk_to_engl.size()) + "\n" +
-		"English entries: " + std::to_string(engl_to_akk.size()) + "\n";
+/**
+ * Merges a group of lines into one entry. For the Akk->Engl dictionary the definitions are the English words
+ * of the lines, and for the Engl->Akk dictionary they're the Akkadian words. If there is more than one line,
+ * duplicate definitions are removed and the definitions are sorted, and only the first relation of each kind
+ * is kept. An entry from a single line is left as it is.
+ */
+static EntryBuilder merge_group(const EnglDict& source, std::span<const LinePosting> group, bool engl, std::pmr::memory_resource* scratch) {
+	const DictEntry& first = source.lines.entries[group[0].line];
+	std::pmr::vector<Symbol> defns(scratch);
+	std::pmr::vector<WordRelation> rels(scratch);
+
+	for (const LinePosting& posting : group) {
+		const DictEntry& entry = source.lines.entries[posting.line];
+		std::span<const WordRelation> line_rels = entry.relations();
+		const size_t rels_begin = rels.size();
+
+		if (engl) {
+			defns.push_back(source.line_words[posting.line]);
+		} else {
+			std::span<const Symbol> engl_words = entry.defns();
+			defns.insert(defns.end(), engl_words.begin(), engl_words.end());
+		}
 
-	OutputDebugStringA(debug_msg.c_str());
-}
+		rels.insert(rels.end(), line_rels.begin(), line_rels.end());
 
-std::optional<const std::vector<DictEntry>*> Dictionary::get_akk(std::wstring& akk) const {
-	if (!akk_to_engl.count(akk)) {
-		return std::nullopt;
+		if (group.size() > 1) {
+			std::sort(rels.begin() + rels_begin, rels.end());
+		}
 	}
 
-	const std::vector<DictEntry>* entry = &akk_to_engl.at(akk);
+	if (group.size() > 1) {
+		dedup_symbols(defns);
+		dedup(rels);
+	}
 
-	return std::optional<const std::vector<DictEntry>*>(entry);
+	return EntryBuilder(first.word_classes, std::move(defns), first.grammar_kind, std::move(rels));
 }
 
-std::optional<const std::vector<DictEntry>*> Dictionary::get_engl(std::wstring& engl) const {
-	if (!engl_to_akk.count(engl)) {
-		return std::nullopt;
+/**
+ * Builds the Akk->Engl entries for the lines in 'source'. If 'words' is given, only the entries for those
+ * words are built.
+ */
+static void build_akk(const EnglDict& source, const std::set<Symbol>* words, EntryBuilderMap& akk_entries) {
+	std::vector<LinePosting> postings;
+	postings.reserve(source.line_words.size());
+
+	for (uint32_t i = 0; i < (uint32_t)source.line_words.size(); i++) {
+		if (!words || words->count(source.line_words[i])) {
+			postings.push_back(LinePosting{ source.line_words[i], i });
+		}
 	}
 
-	const std::vector<DictEntry>* entry = &engl_to_akk.at(engl);
+	std::vector<size_t> group_ends;
+	std::vector<size_t> starts = sort_postings(postings);
+	akk_entries.reserve(akk_entries.size() + starts.size());
 
-	return std::optional<const std::vector<DictEntry>*>(entry);
+	for (size_t start : starts) {
+		std::pmr::vector<EntryBuilder>& key_entries = akk_entries[postings[start].key];
+		group_postings(source, postings, start, group_ends);
+
+		for (size_t group_begin = start; size_t group_end : group_ends) {
+			key_entries.push_back(merge_group(source, std::span(postings.data() + group_begin, group_end - group_begin), false, akk_entries.get_allocator().resource()));
+			group_begin = group_end;
+		}
+	}
 }
 
-std::optional<DictEntry*> Dictionary::get_akk_filters(std::wstring& word, std::vector<GrammarKind> kinds, std::vector<WordClass> word_classes) {
-	if (!akk_to_engl.count(word)) {
-		return std::nullopt;
+/**
+ * Builds the Engl->Akk dictionary from the lines it keeps. Each English word of a line maps back to the line's
+ * Akkadian word, with the line's part of speech, word classes, and relations. Every (word, line) pair is sorted
+ * into a posting list for the word, and each list is split into entries by part of speech and word classes,
+ * so an entry is built once instead of being merged again for every line that adds to it.
+ */
+static void build_engl(EnglDict& engl) {
+	const std::vector<DictEntry>& lines = engl.lines.entries;
+	std::vector<LinePosting> postings;
+	postings.reserve(engl.lines.defns.size());
+
+	for (uint32_t i = 0; i < (uint32_t)lines.size(); i++) {
+		for (Symbol word : lines[i].defns()) {
+			postings.push_back(LinePosting{ word, i });
+		}
 	}
 
-	std::vector<DictEntry>& v = akk_to_engl[word];
+	std::vector<size_t> starts = sort_postings(postings);
 
-	for (size_t i = 0; i < v.size(); i++) {
-		DictEntry& d = v[i];
+	// Keys are packed in the order of their text
+	std::sort(starts.begin(), starts.end(), [&](size_t lhs, size_t rhs) {
+		return Akk::symbols.less(postings[lhs].key, postings[rhs].key);
+	});
 
-		const bool has_kind = std::find(kinds.begin(), kinds.end(), d.grammar_kind) != kinds.end();
+	engl.keys.reserve(starts.size());
+	engl.offsets.reserve(starts.size() + 1);
+	engl.pool.defns.reserve(postings.size());
 
-		if (has_kind && d.has_word_classes(word_classes)) {
-			return std::optional<DictEntry*>(&v[i]);
-		}
-	}
-	
-	return std::nullopt;
-}
+	std::vector<size_t> group_ends;
 
-std::optional<DictEntry*> Dictionary::get_engl_filters(std::wstring& word, GrammarKind grammar_kind, std::vector<WordClass> word_classes) {
-	if (!engl_to_akk.count(word)) {
-		return std::nullopt;
-	}
+	// Each entry is packed as soon as it's merged, so the scratch memory is reset after every key
+	std::byte scratch_buf[ENGL_KEY_SCRATCH_SIZE];
+	std::pmr::monotonic_buffer_resource scratch(scratch_buf, sizeof scratch_buf);
 
-	std::vector<DictEntry>& v = engl_to_akk[word];
+	for (size_t start : starts) {
+		group_postings(engl, postings, start, group_ends);
 
-	for (size_t i = 0; i < v.size(); i++) {
-		DictEntry& d = v[i];
+		engl.keys.push_back(postings[start].key);
+		engl.offsets.push_back((uint32_t)engl.pool.entries.size());
 
-		if (d.grammar_kind == grammar_kind && d.has_word_classes(word_classes)) {
-			return std::optional<DictEntry*>(&v[i]);
+		for (size_t group_begin = start; size_t group_end : group_ends) {
+			EntryBuilder entry = merge_group(engl, std::span(postings.data() + group_begin, group_end - group_begin), true, &scratch);
+			engl.pool.entries.push_back(pack_entry(engl.pool, entry.word_classes, entry.grammar_kind, entry.defns, entry.relations));
+			group_begin = group_end;
 		}
-	}
-
-	return std::nullopt;
-}
 
-std::wstring Dictionary::akk_summary(std::wstring& akk) const {
-	if (!akk_to_engl.count(akk)) {
-		return L"Unknown word";
+		scratch.release();
 	}
 
-	const std::vector<DictEntry>& entries = akk_to_engl.at(akk);
+	engl.offsets.push_back((uint32_t)engl.pool.entries.size());
+	engl.index.build(engl.keys);
+
+	// The number of entries and relations isn't known until the groups are formed, so the pool grew as it was
+	// filled. It's kept for the life of the dictionary, so the unused space is given back.
+	engl.pool.entries.shrink_to_fit();
+	engl.pool.defns.shrink_to_fit();
+	engl.pool.relations.shrink_to_fit();
+}
 
-	std::wstring out;
+DictBuilder::DictBuilder(const std::vector<ParsedLine>& lines) {
+	size_t num_engl_words = 0;
+	size_t num_relations = 0;
 
-	for (const DictEntry& entry : entries) {
-		out += entry.akk_summary(akk) + L"\r\n";
+	for (const ParsedLine& line : lines) {
+		num_engl_words += line.engl_words.size();
+		num_relations += line.rels.size();
 	}
 
-	return out;
-}
+	source->lines.entries.reserve(lines.size());
+	source->lines.defns.reserve(num_engl_words);
+	source->lines.relations.reserve(num_relations);
+	source->line_words.reserve(lines.size());
 
-std::wstring Dictionary::engl_summary(std::wstring& engl) const {
-	if (!engl_to_akk.count(engl)) {
-		return L"Unknown word";
+	for (const ParsedLine& line : lines) {
+		add(line);
 	}
+}
 
-	const std::vector<DictEntry>& entries = engl_to_akk.at(engl);
+void DictBuilder::add(const ParsedLine& line) {
+	EntryPool& pool = source->lines;
 
-	std::wstring out;
+	pool.entries.push_back(pack_entry(pool, line.word_classes, line.grammar_kind, line.engl_words, line.rels));
+	source->line_words.push_back(line.akk_word);
+}
 
-	for (const DictEntry& entry : entries) {
-		out += entry.engl_summary(engl) + L"\r\n";
+void DictBuilder::add(
+	std::string_view akk_word,
+	std::span<const std::string_view> engl_words,
+	GrammarKind grammar_kind,
+	WordClassMask word_classes,
+	std::span<const std::pair<WordRelationKind, std::string_view>> rels
+) {
+	ParsedLine line;
+	line.akk_word = Akk::symbols.intern(akk_word);
+	line.grammar_kind = grammar_kind;
+	line.word_classes = word_classes;
+
+	for (std::string_view engl : engl_words) {
+		line.engl_words.push_back(Akk::symbols.intern(engl));
 	}
 
-	return out;
+	for (const auto& [kind, word] : rels) {
+		line.rels.push_back(WordRelation(kind, Akk::symbols.intern(word)));
+	}
 
+	add(line);
 }
 
-std::pair<std::wstring, DictEntry> Dictionary::random_engl() {
-	std::uniform_int_distribution<> keys_dist(0, (int)engl_to_akk.size() - 1);
-	int engl_index = keys_dist(rng);
-	std::wstring engl = engl_keys[engl_index];
-	const std::vector<DictEntry>& entries = engl_to_akk.at(engl);
-	std::uniform_int_distribution<> entries_dist(0, (int)entries.size() - 1);
-	int index = entries_dist(rng);
-	DictEntry entry = entries[index];
+size_t DictBuilder::size() const {
+	return source->line_words.size();
+}
 
-	return std::make_pair(engl, entry);
+Dictionary DictBuilder::finalize() {
+	return Dictionary(std::move(*this));
 }
 
-std::pair<std::wstring, DictEntry> Dictionary::random_akk() {
-	std::uniform_int_distribution<> keys_dist(0, (int)akk_to_engl.size() - 1);
-	int akk_index = keys_dist(rng);
-	std::wstring akk = akk_keys[akk_index];
-	const std::vector<DictEntry>& entries = akk_to_engl.at(akk);
-	std::uniform_int_distribution<> entries_dist(0, (int)entries.size() - 1);
-	int index = entries_dist(rng);
-	DictEntry entry = entries[index];
+Dictionary::Dictionary(std::wstring filename) : Dictionary(parse_dict_text(read_dict_file(filename))) {}
 
-	return std::make_pair(akk, entry);
-}
+Dictionary::Dictionary(const std::vector<ParsedLine>& lines) : Dictionary(DictBuilder(lines)) {}
 
-void Dictionary::resolve_relations(std::wstring& word, GrammarKind grammar_kind, std::vector<WordRelation>& rels) {
-	for (size_t i = 0; i < rels.size(); i++) {
-		WordRelation& rel = rels[i];
+Dictionary::Dictionary(DictBuilder&& builder) : engl(std::move(builder.source)) {
+	builder.source = std::make_unique<EnglDict>();
 
-		if (rel.kind == WordRelationKind::PreteriteOf) {
-			std::optional<DictEntry*> entry_opt = get_akk_filters(rel.word, { GrammarKind::Verb }, { WordClass::Infinitive });
-			if (!entry_opt.has_value()) {
-				OutputDebugStringW((L"Unknown infinitive mapped by preterite: " + rel.word + L"\n").c_str());
-			}
-			else {
-				DictEntry* entry = *entry_opt;
+	// Everything used to build the entries is freed at once when the build is done
+	std::pmr::monotonic_buffer_resource scratch;
+	EntryBuilderMap akk_entries(&scratch);
+	build_akk(*engl, nullptr, akk_entries);
 
-				entry->add_relation(WordRelation(WordRelationKind::HasPreterite, word));
-			}
-		}
-		else if (rel.kind == WordRelationKind::VerbalAdjOf) {
-			std::optional<DictEntry*> entry_opt = get_akk_filters(rel.word, { GrammarKind::Verb }, { WordClass::Infinitive });
-			if (!entry_opt.has_value()) {
-				OutputDebugStringW((L"Unknown infinitive mapped by verbal adj: " + rel.word + L"\n").c_str());
-			}
-			else {
-				DictEntry* entry = *entry_opt;
+	// Word relations are resolved after the entire dictionary has been read. This means that
+	// a PreteriteOf relation can be defined before the corresponding infinitive, or a 
+	// VerbalAdjOf before the infinitive, etc.
+	resolve_relations(akk_entries, *engl, nullptr, unresolved);
 
-				entry->add_relation(WordRelation(WordRelationKind::HasVerbalAdj, word));
-			}
-		}
-		else if (rel.kind == WordRelationKind::SubstOf) {
-			std::optional<DictEntry*> entry_opt = get_akk_filters(rel.word, { GrammarKind::Adjective }, {});
-			if (!entry_opt.has_value()) {
-				OutputDebugStringW((L"Unknown adjective mapped by substantivized noun: " + rel.word + L"\n").c_str());
-			}
-			else {
-				DictEntry* entry = *entry_opt;
+	pack(akk_entries);
 
-				entry->add_relation(WordRelation(WordRelationKind::HasSubst, word));
+	std::string debug_msg = "Read " + std::to_string(engl->line_words.size()) + " lines\n";
+	debug_msg += "Akk entries: " + std::to_string(akk_keys.size()) + "\n" +
+		"Unresolved relations: " + std::to_string(unresolved.size()) + "\n";
+
+	OutputDebugStringA(debug_msg.c_str());
+}
+
+std::shared_ptr<Dictionary> Dictionary::patch(
+	const std::vector<ParsedLine>& lines,
+	std::span<const ParsedLine> removed,
+	std::span<const ParsedLine> added
+) const {
+	// Every Akkadian key that a changed line contributes to. The entries for an Akkadian word also depend on the
+	// relations that target it, so relation targets are included.
+	std::set<Symbol> akk_words;
+
+	for (std::span<const ParsedLine> changed : { removed, added }) {
+		for (const ParsedLine& line : changed) {
+			akk_words.insert(line.akk_word);
+
+			for (const WordRelation& rel : line.rels) {
+				akk_words.insert(rel.word);
 			}
 		}
-		else if (rel.kind == WordRelationKind::BoundFormOf) {
-			std::optional<DictEntry*> entry_opt_n = get_akk_filters(rel.word, { grammar_kind }, {});
-			std::optional<DictEntry*> entry_opt_v = get_akk_filters(rel.word, { GrammarKind::Verb }, { WordClass::Infinitive });
+	}
 
-			if (!entry_opt_n.has_value() && !entry_opt_v.has_value()) {
-				OutputDebugStringW((L"Unknown n/adj/v mapped by bound form: " + rel.word + L"\n").c_str());
-			}
-			else if (entry_opt_n.has_value()) {
-				DictEntry* entry = *entry_opt_n;
+	// Every other key is unpacked as it is
+	std::pmr::monotonic_buffer_resource scratch;
+	EntryBuilderMap akk_entries(&scratch);
+	akk_entries.reserve(akk_keys.size());
 
-				entry->add_relation(WordRelation(WordRelationKind::HasBoundForm, word));
-			}
-			else {
-				DictEntry* entry = *entry_opt_v;
+	for (size_t i = 0; i < akk_keys.size(); i++) {
+		if (!akk_words.count(akk_keys[i])) {
+			std::pmr::vector<EntryBuilder>& key_entries = akk_entries[akk_keys[i]];
 
-				entry->add_relation(WordRelation(WordRelationKind::HasBoundForm, word));
+			for (const DictEntry& entry : entries(*pool, akk_offsets, i)) {
+				key_entries.push_back(EntryBuilder(entry, &scratch));
 			}
 		}
-		else if (rel.kind == WordRelationKind::GenitiveOf) {
-			std::optional<DictEntry*> entry_opt = get_akk_filters(rel.word, { grammar_kind }, { WordClass::Nominative });
+	}
 
-			if (!entry_opt.has_value()) {
-				OutputDebugStringW((L"Unknown n/adj mapped by genitive case: " + rel.word + L"\n").c_str());
-			}
-			else {
-				DictEntry* entry = *entry_opt;
+	// The affected keys are built again from every line that contributes to them
+	std::shared_ptr<Dictionary> out = std::make_shared<Dictionary>();
+	out->engl = std::move(DictBuilder(lines).source);
+	build_akk(*out->engl, &akk_words, akk_entries);
 
-				entry->add_relation(WordRelation(WordRelationKind::HasGenitive, word));
-			}
-		}
-		else if (rel.kind == WordRelationKind::AccusativeOf) {
-			std::optional<DictEntry*> entry_opt = get_akk_filters(rel.word, { grammar_kind }, { WordClass::Nominative });
+	// Relations between unaffected keys are already in their entries, but every relation is checked again
+	// so that the unresolved relations have the right line numbers
+	resolve_relations(akk_entries, *out->engl, &akk_words, out->unresolved);
+	out->pack(akk_entries);
 
-			if (!entry_opt.has_value()) {
-				OutputDebugStringW((L"Unknown n/adj mapped by accusative case: " + rel.word + L"\n").c_str());
-			}
-			else {
-				DictEntry* entry = *entry_opt;
+	// If the English dictionary has been used, it will probably be used again, so it's built now instead of
+	// the next time it's needed
+	if (engl->ready.load(std::memory_order_acquire)) {
+		out->engl_dict();
+	}
 
-				entry->add_relation(WordRelation(WordRelationKind::HasAccusative, word));
-			}
-		}
-		else if (rel.kind == WordRelationKind::DativeOf) {
-			std::optional<DictEntry*> entry_opt = get_akk_filters(rel.word, { grammar_kind }, { WordClass::Nominative });
+	return out;
+}
 
-			if (!entry_opt.has_value()) {
-				OutputDebugStringW((L"Unknown n/adj/pr mapped by dative case: " + rel.word + L"\n").c_str());
-			}
-			else {
-				DictEntry* entry = *entry_opt;
+std::optional<std::span<const DictEntry>> Dictionary::get_akk(std::string_view akk) const {
+	int pos = akk_index.find(akk);
 
-				entry->add_relation(WordRelation(WordRelationKind::HasDative, word));
-			}
-		}
+	if (pos == -1) {
+		return std::nullopt;
 	}
+
+	return std::optional<std::span<const DictEntry>>(entries(*pool, akk_offsets, pos));
 }
 
-void Dictionary::insert_engl(std::wstring engl, DictEntry entry) {
-	if (!engl_to_akk.count(engl)) {
-		engl_to_akk[engl] = { entry };
-		engl_keys.push_back(engl);
-		return;
+std::optional<std::span<const DictEntry>> Dictionary::get_engl(std::string_view engl) const {
+	const EnglDict& dict = engl_dict();
+	int pos = dict.index.find(engl);
+
+	if (pos == -1) {
+		return std::nullopt;
 	}
 
-	std::vector<DictEntry>& existing_defns = engl_to_akk[engl];
+	return std::optional<std::span<const DictEntry>>(entries(dict.pool, dict.offsets, pos));
+}
+
+std::string Dictionary::akk_summary(std::string_view akk) const {
+	std::optional<std::span<const DictEntry>> entries_opt = get_akk(akk);
 
-	for (size_t i = 0; i < existing_defns.size(); i++) {
-		if (entry.can_merge(existing_defns[i])) {
-			DictEntry merged = existing_defns[i].merge(entry);
-			existing_defns[i] = merged;
-			return;
-		}
+	if (!entries_opt.has_value()) {
+		return "Unknown word";
 	}
 
-	existing_defns.push_back(entry);
+	std::string out;
+
+	for (const DictEntry& entry : *entries_opt) {
+		out += entry.akk_summary(akk) + "\r\n";
+	}
+
+	return out;
 }
 
-void Dictionary::insert_akk(std::wstring akk, DictEntry entry) {
-	if (!akk_to_engl.count(akk)) {
-		akk_to_engl[akk] = { entry };
-		akk_keys.push_back(akk);
-		return;
+std::string Dictionary::engl_summary(std::string_view engl) const {
+	std::optional<std::span<const DictEntry>> entries_opt = get_engl(engl);
+
+	if (!entries_opt.has_value()) {
+		return "Unknown word";
 	}
 
-	std::vector<DictEntry>& existing_defns = akk_to_engl[akk];
+	std::string out;
 
-	for (size_t i = 0; i < existing_defns.size(); i++) {
-		if (entry.can_merge(existing_defns[i])) {
-			DictEntry merged = existing_defns[i].merge(entry);
-			existing_defns[i] = merged;
-			return;
-		}
+	for (const DictEntry& entry : *entries_opt) {
+		out += entry.engl_summary(engl) + "\r\n";
 	}
 
-	existing_defns.push_back(entry);
+	return out;
+
+}
+
+std::pair<std::string, DictEntry> Dictionary::random_engl(std::mt19937& rng) const {
+	const EnglDict& dict = engl_dict();
+	std::uniform_int_distribution<> keys_dist(0, (int)dict.keys.size() - 1);
+	int engl_pos = keys_dist(rng);
+	Symbol engl = dict.keys[engl_pos];
+	std::span<const DictEntry> key_entries = entries(dict.pool, dict.offsets, engl_pos);
+	std::uniform_int_distribution<> entries_dist(0, (int)key_entries.size() - 1);
+	int index = entries_dist(rng);
+	DictEntry entry = key_entries[index];
+
+	return std::make_pair(std::string(Akk::symbols.str(engl)), entry);
+}
+
+std::pair<std::string, DictEntry> Dictionary::random_akk(std::mt19937& rng) const {
+	std::uniform_int_distribution<> keys_dist(0, (int)akk_keys.size() - 1);
+	int akk_pos = keys_dist(rng);
+	Symbol akk = akk_keys[akk_pos];
+	std::span<const DictEntry> key_entries = entries(*pool, akk_offsets, akk_pos);
+	std::uniform_int_distribution<> entries_dist(0, (int)key_entries.size() - 1);
+	int index = entries_dist(rng);
+	DictEntry entry = key_entries[index];
+
+	return std::make_pair(std::string(Akk::symbols.str(akk)), entry);
+}
+
+const std::vector<UnresolvedRelation>& Dictionary::get_unresolved() const {
+	return unresolved;
+}
+
+std::span<const DictEntry> Dictionary::entries(const EntryPool& pool, const std::vector<uint32_t>& offsets, size_t pos) {
+	return std::span<const DictEntry>(pool.entries.data() + offsets[pos], offsets[pos + 1] - offsets[pos]);
+}
+
+const EnglDict& Dictionary::engl_dict() const {
+	std::call_once(engl->built, [this] {
+		build_engl(*engl);
+		engl->ready.store(true, std::memory_order_release);
+	});
+
+	return *engl;
+}
+
+void Dictionary::pack(const EntryBuilderMap& akk_entries) {
+	pool = std::make_unique<EntryPool>();
+	pack_entries(*pool, akk_entries, akk_keys, akk_offsets, akk_index);
+	akk_folded.build(akk_keys);
 }
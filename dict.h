@@ -6,83 +6,99 @@
  */
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <locale>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
 #include <random>
+#include <span>
+#include <stop_token>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
-
-const std::wstring GRAMMAR_KINDS[] = {
-	L"n",
-	L"apr",
-	L"pr",
-	L"adj",
-	L"art",
-	L"conj",
-	L"prep",
-	L"v",
-	L"adv"
+#include "bk_tree.h"
+#include "dawg.h"
+#include "key_columns.h"
+#include "key_index.h"
+#include "letters.h"
+#include "prefix_index.h"
+#include "suffix_array.h"
+#include "symbols.h"
+
+constexpr std::string_view GRAMMAR_KINDS[] = {
+	"n",
+	"apr",
+	"pr",
+	"adj",
+	"art",
+	"conj",
+	"prep",
+	"v",
+	"adv"
 };
 
-const std::wstring WORD_CLASSES[] = {
-	L"m",
-	L"f",
-	L"s",
-	L"dual",
-	L"pl",
-	L"nom",
-	L"inf",
-	L"G",
-	L"id",
-	L"1w",
-	L"2w",
-	L"3w"
+constexpr std::string_view WORD_CLASSES[] = {
+	"m",
+	"f",
+	"s",
+	"dual",
+	"pl",
+	"nom",
+	"inf",
+	"G",
+	"id",
+	"1w",
+	"2w",
+	"3w"
 };
 
 // These relations can be defined in the dictionary. The reverse relations will be set when parsing the dictionary.
 // (For example, you can define a preterite of an infinitive, but not an infinitive of a preterite)
-const std::wstring RELATIONS[] = {
+constexpr std::string_view RELATIONS[] = {
 	// pret(nasāḫum) indicates that the current word is a preterite form of nasāḫum
-	L"pret",
+	"pret",
 	// va(nasāḫum) indicates that the current word is a verbal adjective of nasāḫum
-	L"va",
+	"va",
 	// subst(nakrum) indicates that the current word is a substantivized noun form of nakrum
-	L"subst",
+	"subst",
 	// bf(nakrum) indicates that the current word is the bound form of nakrum. 'nakrum' must
 	// be a noun, adjective, or infinitive
-	L"bf",
+	"bf",
 	// gen(nakrum) indicates that the current word is nakrum in the genitive case. 'nakrum'
 	// must have the nominative word class and the same grammar kind as the current word
-	L"gen",
+	"gen",
 	// acc(nakrum) indicates that the current word is nakrum in the accusative case. 'nakrum'
 	// must have the nominative word class and the same grammar kind as the current word
-	L"acc",
+	"acc",
 	// Dative case for use after 'ana'
-	L"dat",
+	"dat",
 	// Not a real relation - indicates the base of a word. For example, the base of
 	// rubâtum is rubā. Not necessary if the base is obvious
-	L"base"
+	"base"
 };
 
-const std::wstring RELATION_NAMES[] = {
-	L"Preterite of",
-	L"Verbal Adj. of",
-	L"Substantivized N. of",
-	L"Bound Form of",
-	L"Gen. of",
-	L"Acc. of",
-	L"Dative of",
-	L"Base",
-	L"Preterite",
-	L"Substantivized",
-	L"Verbal Adj.",
-	L"Bound Form",
-	L"Gen.",
-	L"Acc.",
-	L"Dative"
+constexpr std::string_view RELATION_NAMES[] = {
+	"Preterite of",
+	"Verbal Adj. of",
+	"Substantivized N. of",
+	"Bound Form of",
+	"Gen. of",
+	"Acc. of",
+	"Dative of",
+	"Base",
+	"Preterite",
+	"Substantivized",
+	"Verbal Adj.",
+	"Bound Form",
+	"Gen.",
+	"Acc.",
+	"Dative"
 };
 
 const size_t NUM_GRAMMAR_KINDS = (sizeof GRAMMAR_KINDS) / (sizeof * GRAMMAR_KINDS);
@@ -93,7 +109,7 @@ const size_t NUM_FULL_RELATIONS = (sizeof RELATION_NAMES) / (sizeof * RELATION_N
 /**
  * Part of speech
  */
-typedef enum {
+typedef enum : uint8_t {
 	Noun,
 	Pronoun,
 	AnaphoricPronoun,
@@ -120,6 +136,17 @@ typedef enum {
 	IIIWeak
 } WordClass;
 
+/**
+ * A set of word classes, with bit 'c' set for each WordClass 'c'
+ */
+typedef uint16_t WordClassMask;
+
+static_assert(NUM_WORD_CLASSES <= 16, "WordClassMask must have a bit for every word class");
+
+constexpr WordClassMask word_class_bit(WordClass word_class) {
+	return (WordClassMask)(1 << word_class);
+}
+
 typedef enum {
 	PreteriteOf,
 	VerbalAdjOf,
@@ -141,54 +168,245 @@ typedef enum {
 
 typedef struct WordRelation {
 	WordRelationKind kind{};
-	std::wstring word{};
+	Symbol word{};
 
-	WordRelation(WordRelationKind kind, std::wstring word);
+	WordRelation(WordRelationKind kind, Symbol word);
 
 	bool operator<(const WordRelation& rhs) const;
 
 } WordRelation;
 
+typedef struct EntryPool EntryPool;
+
 /**
  * An single entry for a word. An entry can have multiple WordClasses and multiple definitions.
  * A single dictionary entry has one part of speech, and can be related to other words in various
- * ways.
+ * ways. Definitions and related words are symbols in Akk::symbols.
+ *
+ * Entries are packed. The definitions and relations of every entry in a dictionary are stored back to back
+ * in the dictionary's EntryPool, and an entry only holds where its own are. An entry is valid for as long as
+ * the dictionary it came from.
  */
 typedef struct DictEntry {
-	std::vector<WordClass> word_types{};
-	std::vector<std::wstring> defns{};
+	const EntryPool* pool{};
+	uint32_t defns_begin{};
+	uint32_t relations_begin{};
+	uint16_t num_defns{};
+	uint16_t num_relations{};
+	WordClassMask word_classes{};
 	GrammarKind grammar_kind{};
-	std::vector<WordRelation> relations{};
 
-	DictEntry() = default;
-
-	DictEntry(
-		const std::vector<WordClass> word_types,
-		const std::vector<std::wstring> defns,
-		GrammarKind grammar_kind,
-		std::vector<WordRelation> relations
-	);
+	std::span<const Symbol> defns() const;
+	std::span<const WordRelation> relations() const;
 
-	void add_relation(WordRelation rel);
+	/**
+	 * Returns the word classes in the order of the WordClass enum
+	 */
+	std::vector<WordClass> word_types() const;
 
-	bool has_word_classes(std::vector<WordClass> classes) const;
+	bool has_word_classes(WordClassMask classes) const;
 
 	/**
 	 * Generate a summary of the dict entry for displaying as a search result. Uses the \r\n line separator
 	 * because plain \n doesn't work with edit controls.
 	 */
-	std::wstring akk_summary(std::wstring& word) const;
+	std::string akk_summary(std::string_view word) const;
 
 	/**
 	 * Generates a summary of the dict entry. The summary is shorter for an English word. Uses the \r\n line 
 	 * separator because plain \n doesn't work with edit controls.
 	 */
-	std::wstring engl_summary(std::wstring& word) const;
-
-	DictEntry merge(DictEntry& other) const;
-	bool can_merge(DictEntry& other) const;
+	std::string engl_summary(std::string_view word) const;
 } DictEntry;
 
+/**
+ * Storage for the entries of a dictionary. The entries for a key are next to each other in 'entries'.
+ */
+typedef struct EntryPool {
+	std::vector<DictEntry> entries{};
+	std::vector<Symbol> defns{};
+	std::vector<WordRelation> relations{};
+} EntryPool;
+
+typedef struct EntryBuilder EntryBuilder;
+typedef std::pmr::unordered_map<Symbol, std::pmr::vector<EntryBuilder>> EntryBuilderMap;
+
+/**
+ * One line of the dictionary file, parsed but not yet inserted into a dictionary. See Dictionary(filename)
+ * for the format of a line.
+ */
+typedef struct ParsedLine {
+	Symbol akk_word{};
+	std::vector<Symbol> engl_words{};
+	GrammarKind grammar_kind{};
+	WordClassMask word_classes{};
+	std::vector<WordRelation> rels{};
+	// True if the line has the optional word class/relation field
+	bool has_attrs{};
+} ParsedLine;
+
+/**
+ * A relation in the dictionary file that couldn't be resolved, because the target word doesn't exist or doesn't
+ * have an entry with the part of speech and word classes that the relation needs
+ */
+typedef struct UnresolvedRelation {
+	// Line of the word that has the relation, starting at 1
+	int line{};
+	Symbol word{};
+	WordRelationKind kind{};
+	Symbol target{};
+
+	std::string message() const;
+} UnresolvedRelation;
+
+/**
+ * The Engl->Akk half of a dictionary. It isn't built until something needs it, so a session that only uses the
+ * Akkadian side never pays for merging an entry for every English definition. Until then, only the lines it's
+ * built from are kept.
+ */
+typedef struct EnglDict {
+	std::once_flag built{};
+	// Set once the dictionary below has been built
+	std::atomic<bool> ready{};
+	// The lines of the dictionary file as unmerged entries. The definitions of line i's entry are the
+	// English words of the line, and line_words[i] is its Akkadian word.
+	EntryPool lines{};
+	std::vector<Symbol> line_words{};
+
+	EntryPool pool{};
+	std::vector<Symbol> keys{};
+	std::vector<uint32_t> offsets{};
+	KeyIndex index{};
+
+	// For searching the keys. This isn't built until the first search, even if the dictionary above is.
+	std::once_flag suffixes_built{};
+	SuffixArray suffixes{};
+} EnglDict;
+
+/**
+ * Indexes over the Akkadian keys that are only used for searching. Like EnglDict, each one isn't built until the
+ * first search that needs it.
+ */
+typedef struct AkkSearchIndex {
+	// For the fuzzy search
+	std::once_flag tree_built{};
+	BKTree tree{};
+
+	// For the prefix search
+	std::once_flag prefixes_built{};
+	PrefixIndex prefixes{};
+
+	// For the fuzzy search with FuzzyIndex::Automaton
+	std::once_flag dawg_built{};
+	Dawg dawg{};
+
+	// For search-as-you-type (see search_session.h)
+	std::once_flag columns_built{};
+	KeyColumns columns{};
+} AkkSearchIndex;
+
+/**
+ * The index used to find candidates for the fuzzy Akkadian search. Both give the same results.
+ */
+typedef enum {
+	// BK-tree (see bk_tree.h)
+	MetricTree,
+	// Word graph walked with a Levenshtein automaton (see dawg.h)
+	Automaton
+} FuzzyIndex;
+
+/**
+ * Counters for one search, for measuring the search algorithms
+ */
+typedef struct SearchStats {
+	// Cells of the edit distance table computed by the fuzzy search. The bit-parallel kernel (see
+	// edit_distance.h) counts every cell of the table, even though it computes a column at a time.
+	size_t dp_cells{};
+} SearchStats;
+
+typedef struct Dictionary Dictionary;
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * Builds a dictionary one line at a time. Lines are only appended to flat buffers as they're added; finalize()
+ * sorts the lines by key and merges the entries for each key in one pass, and then resolves the relations. The
+ * dictionary file is loaded this way, and a dictionary can also be put together in code without a file.
+ */
+typedef struct DictBuilder {
+	DictBuilder() = default;
+
+	/**
+	 * Adds all of the lines of a parsed dictionary file
+	 */
+	DictBuilder(const std::vector<ParsedLine>& lines);
+
+	void add(const ParsedLine& line);
+
+	/**
+	 * Adds a line given as text. The relations are (relation, target word) pairs, as they would be written in
+	 * the dictionary file.
+	 */
+	void add(
+		std::string_view akk_word,
+		std::span<const std::string_view> engl_words,
+		GrammarKind grammar_kind,
+		WordClassMask word_classes = 0,
+		std::span<const std::pair<WordRelationKind, std::string_view>> rels = {}
+	);
+
+	/**
+	 * Returns the number of lines added so far
+	 */
+	size_t size() const;
+
+	/**
+	 * Builds the dictionary from the lines that have been added. The builder is empty afterwards.
+	 */
+	Dictionary finalize();
+
+private:
+	friend struct Dictionary;
+
+	// The lines in the same form that EnglDict keeps them, so that they can be handed to the dictionary as they are
+	std::unique_ptr<EnglDict> source{ std::make_unique<EnglDict>() };
+} DictBuilder;
+
+/**
+ * The size and last write time of a file. A snapshot stores the stamp of the dictionary file it was compiled
+ * from, so that it can tell when the file has changed.
+ */
+typedef struct FileStamp {
+	uint64_t size{};
+	uint64_t mtime{};
+
+	bool operator==(const FileStamp& other) const = default;
+} FileStamp;
+
+/**
+ * Gets the stamp of a file. Returns false if the file doesn't exist.
+ */
+bool file_stamp(std::wstring& filename, FileStamp& stamp);
+
+/**
+ * Reads a dictionary file into a UTF-8 string. A byte order mark is removed if the file has one.
+ */
+std::string read_dict_file(std::wstring& filename);
+
+/**
+ * Splits the text of a dictionary file into lines. The lines are views into 'text'.
+ */
+std::vector<std::string_view> split_dict_lines(std::string_view text);
+
+/**
+ * Parses a single line of a dictionary file. 'line_num' is only used for errors.
+ */
+ParsedLine parse_dict_line(std::string_view line, int line_num);
+
+/**
+ * Parses every line of a dictionary file. Large files are split up and parsed in parallel.
+ */
+std::vector<ParsedLine> parse_dict_text(std::string_view text);
+
 /**
  * The core data structure of the application. A Dictionary is really two dictionaries, one from Akkadian
  * to English and the other from English to Akkadian. The dictionary is constructed from a file that maps 
@@ -196,20 +414,30 @@ typedef struct DictEntry {
  * The Engl->Akk dictionary is constructed by mapping each definition given for a word back to the word.
  * Word classes/attributes and part of speech are preserved. If two Akkadian words have the same part of
  * speech and share an English definition, their corresponding Engl->Akk dictionary will be merged,
- * so that the English definition maps to both Akkadian words.
+ * so that the English definition maps to both Akkadian words. The Engl->Akk dictionary is only built the
+ * first time it's used (see EnglDict).
  * 
  * Each key word in a dictionary may have several entries. For example, 'nakrum' is both an adjective and a
  * noun (substantivized). These should be separate definitions, so the key 'nakrum' in the Akk->Engl dictionary
  * will have two DictEntries. The fact that one is a substantivization of the other is represented with a
  * bidirectional relation (see WordRelation).
  * 
- * The keys are kept separately in vectors to allow efficient random selection of keys. This is used for
- * the practice functionality. Note that the key word chosen follows a uniform distribution, but the dict
- * entry chosen does not, because words can map to more than one dict entry.
+ * All words and definitions are stored as symbols (see symbols.h), so the dictionaries are keyed by symbol.
+ * Text is only looked up when a word is shown to the user or searched for. All text going in and out of a
+ * dictionary is UTF-8; the UI converts to and from wide strings. Entries are built by a DictBuilder
+ * while the dictionary is loaded, and then packed into an EntryPool in key order.
+ * 
+ * The keys are kept in vectors, sorted alphabetically, to allow efficient random selection of keys.
+ * This is used for the practice functionality. Note that the key word chosen follows a uniform distribution, but the dict
+ * entry chosen does not, because words can map to more than one dict entry. Exact lookups go through a KeyIndex
+ * from the text of a key to its position.
  */
 typedef struct Dictionary {
 	Dictionary() = default;
 
+	Dictionary(Dictionary&&) = default;
+	Dictionary& operator=(Dictionary&&) = default;
+
 	/**
 	 * Loads the dictionary from a file following a CSV format. Each line of the file should have 3 or 4
 	 * comma-separated fields. The fields are as follows:
@@ -227,51 +455,179 @@ typedef struct Dictionary {
 	 */
 	Dictionary(std::wstring filename);
 
-	std::optional<const std::vector<DictEntry>*> get_akk(std::wstring& akk) const;
-	std::optional<const std::vector<DictEntry>*> get_engl(std::wstring& engl) const;
+	/**
+	 * Builds the dictionary from the lines of a dictionary file that have already been parsed.
+	 */
+	Dictionary(const std::vector<ParsedLine>& lines);
+
+	/**
+	 * Builds the dictionary from the lines in a builder. See DictBuilder::finalize.
+	 */
+	Dictionary(DictBuilder&& builder);
+
+	/**
+	 * Loads the dictionary from a compiled snapshot if there is an up-to-date one, otherwise parses the source
+	 * file and compiles a new snapshot for next time. A snapshot that can't be written is not an error; the
+	 * dictionary will just be parsed again on the next run.
+	 *
+	 * If 'source_stamp' isn't null, it's set to the stamp of the source file from before it was loaded, or left
+	 * empty if the file couldn't be stamped. If the file has the same stamp later, it hasn't changed since the
+	 * dictionary was loaded (see DictReloader).
+	 */
+	static Dictionary load(std::wstring filename, std::wstring snapshot_filename, FileStamp* source_stamp = nullptr);
+
+	/**
+	 * Loads a dictionary from a snapshot file created by save_snapshot. The snapshot is memory-mapped and
+	 * decoded straight from the mapping, but it isn't used in place: its distinct strings are interned into
+	 * Akk::symbols once each, and the key index and folded keys are restored without being rebuilt. Nothing is
+	 * returned if the snapshot doesn't exist, was compiled by an incompatible version, fails its checksum, or is
+	 * stale (the source file has changed since the snapshot was compiled). See snapshot.cpp for the format.
+	 */
+	static std::optional<Dictionary> load_snapshot(std::wstring& snapshot_filename, std::wstring& source_filename);
+
+	/**
+	 * Compiles the dictionary into a snapshot file. Relations are already resolved and keys are already sorted
+	 * in the snapshot, so loading it doesn't need to do any of the work done by the Dictionary(filename)
+	 * constructor. 'source_stamp' is stored so that stale snapshots can be detected. It has to be the stamp of
+	 * the source file from before the file was read, so that if the file changed while it was being read, the
+	 * snapshot is stale instead of matching the new file. Returns false if the snapshot couldn't be written.
+	 */
+	bool save_snapshot(std::wstring& snapshot_filename, const FileStamp& source_stamp) const;
+
+	/**
+	 * Returns a copy of this dictionary with some lines of the source file replaced. 'lines' are all of the
+	 * lines in the new version of the file, and 'removed' and 'added' are the lines that changed. Only the
+	 * Akkadian keys that appear in the changed lines (as a word or relation target) are rebuilt; everything
+	 * else is copied. The Engl->Akk dictionary is built from 'lines' again, right away if this dictionary's
+	 * has been used and on first use otherwise. The result is the same as building a new dictionary from 'lines'.
+	 */
+	std::shared_ptr<Dictionary> patch(
+		const std::vector<ParsedLine>& lines,
+		std::span<const ParsedLine> removed,
+		std::span<const ParsedLine> added
+	) const;
+
+	std::optional<std::span<const DictEntry>> get_akk(std::string_view akk) const;
+	std::optional<std::span<const DictEntry>> get_engl(std::string_view engl) const;
 
 	/**
 	 * Searches all English entries and returns results in ascending order of Levenshtein
 	 * distance. The number of items returned is at most 'limit', and the returned vector
 	 * will contain no words that have a Levenshtein distance from the query word that is greater
-	 * than 'cutoff'. See search.cpp for an explanation of the search algorithm.
+	 * than 'cutoff'. See search.cpp for an explanation of the search algorithm. 'fuzzy_index' selects the index
+	 * used by the fuzzy Akkadian search. If 'stats' isn't null, the search's counters are added to it. If
+	 * 'thread_pool' isn't null, the fuzzy Akkadian search is split into shards that are searched on the pool; the
+	 * results are the same either way. The other searches use indexes that are fast enough on one thread.
+	 * If a stop is requested on 'stop' during the fuzzy Akkadian search, it throws SearchCancelled (see errors.h).
+	 * The search checks for it before each shard and every so many keys.
 	 */
-	std::vector<std::wstring> search(std::wstring& query, size_t limit, int cutoff, bool engl) const;
+	std::vector<std::string> search(
+		std::string_view query,
+		size_t limit,
+		int cutoff,
+		bool engl,
+		FuzzyIndex fuzzy_index = MetricTree,
+		SearchStats* stats = nullptr,
+		ThreadPool* thread_pool = nullptr,
+		std::stop_token stop = {}
+	) const;
 
-	std::pair<std::wstring, DictEntry> random_engl();
-	std::pair<std::wstring, DictEntry> random_akk();
+	/**
+	 * Searches for many queries at once and returns the results for each query, in order. The results for a query
+	 * are the same as from search(). Queries that are the same are only searched once, and the fuzzy Akkadian
+	 * search checks each key against a block of queries at a time instead of scanning all the keys for every
+	 * query. If 'thread_pool' isn't null, the blocks are searched on the pool.
+	 */
+	std::vector<std::vector<std::string>> search_batch(
+		std::span<const std::string_view> queries,
+		size_t limit,
+		int cutoff,
+		bool engl,
+		FuzzyIndex fuzzy_index = MetricTree,
+		SearchStats* stats = nullptr,
+		ThreadPool* thread_pool = nullptr
+	) const;
+
+	std::pair<std::string, DictEntry> random_engl(std::mt19937& rng) const;
+	std::pair<std::string, DictEntry> random_akk(std::mt19937& rng) const;
+
+	std::string akk_summary(std::string_view akk) const;
+	std::string engl_summary(std::string_view engl) const;
 
-	std::wstring akk_summary(std::wstring& akk) const;
-	std::wstring engl_summary(std::wstring& engl) const;
+	/**
+	 * Returns the relations in the dictionary file that couldn't be resolved, in the order they appear in the file
+	 */
+	const std::vector<UnresolvedRelation>& get_unresolved() const;
 
 private:
-	std::map<std::wstring, std::vector<DictEntry>> engl_to_akk{};
-	std::map<std::wstring, std::vector<DictEntry>> akk_to_engl{};
-	std::vector<std::wstring> engl_keys{};
-	std::vector<std::wstring> akk_keys{};
-	std::mt19937 rng{};
+	friend struct SearchSession;
+
+	std::unique_ptr<EntryPool> pool{};
+	std::vector<Symbol> akk_keys{};
+	// The entries for the key at position i are [offsets[i], offsets[i + 1]) in the pool
+	std::vector<uint32_t> akk_offsets{};
+	KeyIndex akk_index{};
+	// akk_folded[i] is akk_keys[i] without diacritical marks, for searching
+	FoldedKeys akk_folded{};
+	std::unique_ptr<EnglDict> engl{ std::make_unique<EnglDict>() };
+	std::unique_ptr<AkkSearchIndex> akk_search{ std::make_unique<AkkSearchIndex>() };
+	std::vector<UnresolvedRelation> unresolved{};
+
+	std::vector<std::string> lev_search(
+		std::u32string_view folded_query,
+		size_t limit,
+		int cutoff,
+		FuzzyIndex fuzzy_index,
+		SearchStats* stats,
+		ThreadPool* thread_pool,
+		std::stop_token stop
+	) const;
+	std::vector<std::vector<std::string>> lev_search_batch(
+		std::span<const std::u32string> folded_queries,
+		size_t limit,
+		int cutoff,
+		FuzzyIndex fuzzy_index,
+		SearchStats* stats,
+		ThreadPool* thread_pool
+	) const;
+	std::vector<std::string> basic_search(std::u32string_view folded_query, size_t limit) const;
+	std::vector<std::string> engl_search(std::string_view query, size_t limit) const;
+	std::vector<std::string> top_keys(const TopScores& top) const;
+
+	static std::span<const DictEntry> entries(const EntryPool& pool, const std::vector<uint32_t>& offsets, size_t pos);
 
-	std::vector<std::wstring> lev_search(std::wstring& query, size_t limit, int cutoff) const;
-	std::vector<std::wstring> basic_search(std::wstring& query, size_t limit) const;
-	std::vector<std::wstring> engl_search(std::wstring& query, size_t limit) const;
+	/**
+	 * Returns the Engl->Akk dictionary, building it first if this is the first time it's needed. Safe to call
+	 * from any number of threads at once.
+	 */
+	const EnglDict& engl_dict() const;
 
-	void resolve_relations(std::wstring& word, GrammarKind grammar_kind, std::vector<WordRelation>& rels);
+	/**
+	 * Return the Akkadian search indexes, building them first if this is the first time they're needed. Safe
+	 * to call from any number of threads at once.
+	 */
+	const BKTree& akk_tree() const;
+	const PrefixIndex& akk_prefixes() const;
+	const Dawg& akk_dawg() const;
+	const KeyColumns& akk_columns() const;
 
-	void insert_engl(std::wstring engl, DictEntry entry);
-	void insert_akk(std::wstring akk, DictEntry entry);
+	/**
+	 * Returns the index for searching the English keys, building the Engl->Akk dictionary and then the index first
+	 * if they haven't been built yet. Safe to call from any number of threads at once.
+	 */
+	const SuffixArray& engl_suffixes() const;
 
-	std::optional<DictEntry*> get_akk_filters(
-		std::wstring& word,
-		std::vector<GrammarKind> kinds,
-		std::vector<WordClass> word_classes
-	);
-	std::optional<DictEntry*> get_engl_filters(
-		std::wstring& word,
-		GrammarKind grammar_kind,
-		std::vector<WordClass> word_classes
-	);
+	/**
+	 * Packs built Akkadian entries into a new EntryPool
+	 */
+	void pack(const EntryBuilderMap& akk_entries);
 } Dictionary;
 
 namespace Akk {
-	extern Dictionary dict;
+	/**
+	 * The current version of the dictionary. A new version is swapped in when the dictionary file is reloaded
+	 * (see reload.h), so readers should load the pointer once and use that version for as long as they need
+	 * consistent results. An old version is destroyed when the last reader releases it.
+	 */
+	extern std::atomic<std::shared_ptr<const Dictionary>> dict;
 }
@@ -0,0 +1,252 @@
+#include "edit_distance.h"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+int lev_distance(std::u32string_view s, std::u32string_view t) {
+	if (s.empty()) {
+		return (int)t.size();
+	}
+
+	if (t.empty()) {
+		return (int)s.size();
+	}
+
+	std::vector<int> row(s.size() + 1);
+	std::iota(row.begin(), row.end(), 0);
+
+	for (size_t j = 1; j <= t.size(); j++) {
+		// The value to the upper left of the cell being computed
+		int diag = row[0];
+		row[0] = (int)j;
+
+		for (size_t i = 1; i <= s.size(); i++) {
+			const int cost = s[i - 1] == t[j - 1] ? 0 : 1;
+			const int cell = (std::min)({ row[i] + 1, row[i - 1] + 1, diag + cost });
+
+			diag = row[i];
+			row[i] = cell;
+		}
+	}
+
+	return row[s.size()];
+}
+
+int lev_distance_within(std::u32string_view s, std::u32string_view t, int max_dist, size_t& cells) {
+	const int n = (int)s.size();
+	const int m = (int)t.size();
+	const int over = max_dist + 1;
+
+	if (std::abs(n - m) > max_dist) {
+		return over;
+	}
+
+	// Rows of up to ROW_BUF_SIZE cells are kept on the stack
+	const int ROW_BUF_SIZE = 64;
+	int row_buf[ROW_BUF_SIZE + 1];
+	std::vector<int> row_vec;
+	int* row = row_buf;
+
+	if (n > ROW_BUF_SIZE) {
+		row_vec.resize(n + 1);
+		row = row_vec.data();
+	}
+
+	// Cells outside the band are never read as anything but 'over'
+	for (int i = 0; i <= n; i++) {
+		row[i] = (std::min)(i, over);
+	}
+
+	for (int j = 1; j <= m; j++) {
+		const int lo = (std::max)(1, j - max_dist);
+		const int hi = (std::min)(n, j + max_dist);
+		// The value to the upper left of the cell being computed
+		int diag = row[lo - 1];
+
+		row[lo - 1] = lo == 1 ? (std::min)(j, over) : over;
+
+		int row_min = row[lo - 1];
+
+		for (int i = lo; i <= hi; i++) {
+			const int cost = s[i - 1] == t[j - 1] ? 0 : 1;
+			const int cell = (std::min)({ row[i] + 1, row[i - 1] + 1, diag + cost, over });
+
+			diag = row[i];
+			row[i] = cell;
+			row_min = (std::min)(row_min, cell);
+		}
+
+		cells += hi - lo + 1;
+
+		if (row_min > max_dist) {
+			return over;
+		}
+	}
+
+	return row[n];
+}
+
+LevPattern::LevPattern(std::u32string_view pattern) : pattern(pattern) {
+	if (pattern.size() > MAX_SIZE) {
+		return;
+	}
+
+	for (size_t i = 0; i < pattern.size(); i++) {
+		const char32_t c = pattern[i];
+		const uint64_t bit = (uint64_t)1 << i;
+
+		if (c < ASCII_SIZE) {
+			ascii_masks[c] |= bit;
+			continue;
+		}
+
+		auto it = std::find_if(other_masks.begin(), other_masks.end(), [c](const std::pair<char32_t, uint64_t>& item) {
+			return item.first == c;
+		});
+
+		if (it == other_masks.end()) {
+			other_masks.push_back(std::make_pair(c, bit));
+		}
+		else {
+			it->second |= bit;
+		}
+	}
+}
+
+int LevPattern::distance(std::u32string_view text) const {
+	const size_t m = pattern.size();
+
+	if (m > MAX_SIZE) {
+		return lev_distance(pattern, text);
+	}
+
+	if (m == 0) {
+		return (int)text.size();
+	}
+
+	Column column = first_column();
+
+	for (char32_t c : text) {
+		step(column, c);
+	}
+
+	return column.score;
+}
+
+int LevPattern::distance_within(std::u32string_view text, int max_dist, size_t& cells) const {
+	const int m = (int)pattern.size();
+	const int n = (int)text.size();
+	const int over = max_dist + 1;
+
+	if (std::abs(m - n) > max_dist) {
+		return over;
+	}
+
+	if (m > (int)MAX_SIZE) {
+		return lev_distance_within(pattern, text, max_dist, cells);
+	}
+
+	if (m == 0) {
+		return (std::min)(n, over);
+	}
+
+	Column column = first_column();
+
+	for (int j = 0; j < n; j++) {
+		step(column, text[j]);
+
+		// Each char that's left can lower the score by at most one
+		if (column.score - (n - j - 1) > max_dist) {
+			cells += (size_t)m * (j + 1);
+			return over;
+		}
+	}
+
+	cells += (size_t)m * n;
+
+	return (std::min)(column.score, over);
+}
+
+size_t LevPattern::size() const {
+	return pattern.size();
+}
+
+/**
+ * Returns the column of the DP table for an empty text
+ */
+LevPattern::Column LevPattern::first_column() const {
+	const size_t m = pattern.size();
+	const uint64_t last = (uint64_t)1 << (m - 1);
+
+	return Column{ m == MAX_SIZE ? ~(uint64_t)0 : (last << 1) - 1, 0, (int)m };
+}
+
+/**
+ * Computes the next column of the DP table, for one more char of the text
+ */
+void LevPattern::step(Column& column, char32_t c) const {
+	const uint64_t last = (uint64_t)1 << (pattern.size() - 1);
+	const uint64_t eq = mask(c);
+	const uint64_t xv = eq | column.mv;
+	const uint64_t xh = (((eq & column.pv) + column.pv) ^ column.pv) | eq;
+	uint64_t ph = column.mv | ~(xh | column.pv);
+	uint64_t mh = column.pv & xh;
+
+	if (ph & last) {
+		column.score++;
+	}
+	else if (mh & last) {
+		column.score--;
+	}
+
+	// The top row of the table counts up from 0, so a +1 is shifted into the first row
+	ph = (ph << 1) | 1;
+	mh <<= 1;
+	column.pv = mh | ~(xv | ph);
+	column.mv = ph & xv;
+}
+
+uint64_t LevPattern::mask(char32_t c) const {
+	if (c < ASCII_SIZE) {
+		return ascii_masks[c];
+	}
+
+	for (const std::pair<char32_t, uint64_t>& item : other_masks) {
+		if (item.first == c) {
+			return item.second;
+		}
+	}
+
+	return 0;
+}
+
+TopScores::TopScores(size_t limit) : limit(limit) {}
+
+void TopScores::add(int score, uint32_t pos) {
+	const std::pair<int, uint32_t> item(score, pos);
+
+	if (heap.size() < limit) {
+		heap.push_back(item);
+		std::push_heap(heap.begin(), heap.end());
+	}
+	else if (limit > 0 && item < heap.front()) {
+		std::pop_heap(heap.begin(), heap.end());
+		heap.back() = item;
+		std::push_heap(heap.begin(), heap.end());
+	}
+}
+
+int TopScores::max_score() const {
+	if (limit == 0) {
+		return -1;
+	}
+
+	return heap.size() < limit ? INT_MAX : heap.front().first;
+}
+
+std::vector<std::pair<int, uint32_t>> TopScores::sorted() const {
+	std::vector<std::pair<int, uint32_t>> out(heap);
+	std::sort_heap(out.begin(), out.end());
+
+	return out;
+}
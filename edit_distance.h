@@ -0,0 +1,107 @@
+/**
+ * Levenshtein distance and ranking for the fuzzy search.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Returns the Levenshtein distance between two strings, comparing chars exactly. This is the plain
+ * dynamic programming algorithm, adapted from
+ * https://www.codeproject.com/Articles/13525/Fast-memory-efficient-Levenshtein-algorithm-2.
+ * LevPattern is faster when one string is compared to many others.
+ */
+int lev_distance(std::u32string_view s, std::u32string_view t);
+
+/**
+ * Returns the Levenshtein distance between two strings if it's at most 'max_dist', otherwise max_dist + 1.
+ * Only the cells within max_dist of the diagonal of the DP table are computed (Ukkonen, "Algorithms for
+ * approximate string matching", 1985), and it stops as soon as every cell in a row is over max_dist. The
+ * number of cells computed is added to 'cells'.
+ */
+int lev_distance_within(std::u32string_view s, std::u32string_view t, int max_dist, size_t& cells);
+
+/**
+ * A string prepared for computing its Levenshtein distance to many other strings, using the bit-parallel
+ * algorithm from Myers, "A fast bit-vector algorithm for approximate string matching based on dynamic
+ * programming" (1999), in the form given by Hyyrö. Each char of the pattern is a bit in a 64-bit word, so a whole
+ * column of the DP table is computed with a few word operations, and nothing is allocated per comparison.
+ * Patterns longer than 64 chars fall back to lev_distance.
+ *
+ * Chars are compared exactly. To ignore diacritical marks, fold both strings first (see search.cpp).
+ */
+typedef struct LevPattern {
+	/**
+	 * Prepares a pattern. The pattern string is not copied, so it has to outlive the LevPattern.
+	 */
+	LevPattern(std::u32string_view pattern);
+
+	/**
+	 * Returns the Levenshtein distance from the pattern to 'text'
+	 */
+	int distance(std::u32string_view text) const;
+
+	/**
+	 * Returns the Levenshtein distance from the pattern to 'text' if it's at most 'max_dist', otherwise
+	 * max_dist + 1, the same as lev_distance_within. It stops once the score is too far over max_dist for the rest
+	 * of the text to bring it back down. Each char of the text computes a column of size() cells, which are added
+	 * to 'cells'.
+	 */
+	int distance_within(std::u32string_view text, int max_dist, size_t& cells) const;
+
+	size_t size() const;
+
+private:
+	static const size_t MAX_SIZE = 64;
+	static const size_t ASCII_SIZE = 128;
+
+	// Pv and Mv hold the vertical deltas (+1 and -1) of a column of the DP table, one bit per pattern char. The
+	// score is the bottom cell of the column.
+	typedef struct Column {
+		uint64_t pv{};
+		uint64_t mv{};
+		int score{};
+	} Column;
+
+	std::u32string_view pattern{};
+	// For each char, the positions in the pattern where it appears. ASCII chars are looked up directly and
+	// the rest are searched for; the Akkadian letters with marks are ASCII once they're folded.
+	uint64_t ascii_masks[ASCII_SIZE]{};
+	std::vector<std::pair<char32_t, uint64_t>> other_masks{};
+
+	uint64_t mask(char32_t c) const;
+	Column first_column() const;
+	void step(Column& column, char32_t c) const;
+} LevPattern;
+
+/**
+ * The best 'limit' matches added so far, by lowest score and then lowest position, so ties always come out the
+ * same way no matter what order the matches are added in. The worst of them is on top of a max-heap, so a better
+ * match replaces it in O(log limit) and nothing is sorted until the end.
+ */
+typedef struct TopScores {
+	TopScores(size_t limit);
+
+	void add(int score, uint32_t pos);
+
+	/**
+	 * Returns the highest score that could still be added. Once there are 'limit' matches, a search can skip
+	 * anything that scores higher than the worst of them.
+	 */
+	int max_score() const;
+
+	/**
+	 * Returns the matches as (score, position), best first
+	 */
+	std::vector<std::pair<int, uint32_t>> sorted() const;
+
+private:
+	size_t limit{};
+	std::vector<std::pair<int, uint32_t>> heap{};
+} TopScores;
@@ -27,3 +27,8 @@ typedef struct DictParseError {
 	std::wstring message();
 
 } DictParseError;
+
+/**
+ * Thrown out of a search that was cancelled with its stop token
+ */
+typedef struct SearchCancelled {} SearchCancelled;
@@ -1,15 +1,47 @@
 ﻿#include "common.h"
 #include <algorithm>
 #include <assert.h>
+#include <chrono>
 #include <iomanip>
 #include <CommCtrl.h>
 #include <sstream>
 #include <string>
 #include <windowsx.h>
+#include "async_search.h"
 #include "components.h"
 #include "errors.h"
 #include "handlers.h"
 #include "resource.h"
+#include "search_cache.h"
+#include "search_session.h"
+
+/**
+ * The dictionary works with UTF-8 text and the Windows controls work with UTF-16, so text is converted
+ * whenever it crosses between the two.
+ */
+static std::wstring to_wide(std::string_view str) {
+    if (str.empty()) {
+        return L"";
+    }
+
+    int len = MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), NULL, 0);
+    std::wstring out(len, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), out.data(), len);
+
+    return out;
+}
+
+static std::string to_utf8(std::wstring_view str) {
+    if (str.empty()) {
+        return "";
+    }
+
+    int len = WideCharToMultiByte(CP_UTF8, 0, str.data(), (int)str.size(), NULL, 0, NULL, NULL);
+    std::string out(len, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, str.data(), (int)str.size(), out.data(), len, NULL, NULL);
+
+    return out;
+}
 
 static std::wstring get_input_txt(HWND hdlg, int res_id) {
     wchar_t buf[MAX_ANSWER_CHARS + 1];
@@ -19,11 +51,12 @@ static std::wstring get_input_txt(HWND hdlg, int res_id) {
     return std::wstring(buf);
 }
 
-static std::wstring get_word_class_str(std::vector<WordClass>& classes) {
-    std::wstring out;
+static std::string get_word_class_str(const std::vector<WordClass>& classes) {
+    std::string out;
 
     for (size_t i = 0; i < classes.size() - 1; i++) {
-        out += WORD_CLASSES[classes[i]] + L", ";
+        out += WORD_CLASSES[classes[i]];
+        out += ", ";
     }
     
     if (classes.size() != 0) {
@@ -44,10 +77,10 @@ static std::wstring trim(std::wstring& str) {
     size_t start = 0;
     size_t end = str.size();
 
-    while (is_whitespace(str[start])) start++;
-    while (is_whitespace(str[end - 1])) end--;
+    while (start < end && is_whitespace(str[start])) start++;
+    while (end > start && is_whitespace(str[end - 1])) end--;
 
-    if (end < start) {
+    if (start == end) {
         return L"";
     }
 
@@ -57,20 +90,22 @@ static std::wstring trim(std::wstring& str) {
 void PracticeState::reset() {
     correct = 0;
     total = 0;
-    word = L"";
+    word = "";
 }
 
-void PracticeState::new_word(Dictionary& dict, bool engl) {
-    std::pair<std::wstring, DictEntry> item = engl ? dict.random_engl() : dict.random_akk();
+void PracticeState::new_word(std::shared_ptr<const Dictionary> dict, bool engl) {
+    std::pair<std::string, DictEntry> item = engl ? dict->random_engl(rng) : dict->random_akk(rng);
+    entry_dict = dict;
     word = item.first;
     entry = item.second;
 }
 
 bool PracticeState::accept_answer(std::wstring& answer) {
     bool retval = false;
+    std::string utf8_answer = to_utf8(answer);
 
-    for (std::wstring defn : entry.defns) {
-        if (defn == answer) {
+    for (Symbol defn : entry.defns()) {
+        if (Akk::symbols.str(defn) == utf8_answer) {
             correct++;
             retval = true;
         }
@@ -80,7 +115,7 @@ bool PracticeState::accept_answer(std::wstring& answer) {
     return retval;
 }
 
-std::wstring PracticeState::get_summary(Dictionary& dict, bool engl, bool wasCorrect, std::wstring answer = L"") {
+std::wstring PracticeState::get_summary(const Dictionary& dict, bool engl, bool wasCorrect, std::wstring answer = L"") {
     if (total == 0) {
         return L"0/0";
     }
@@ -89,12 +124,13 @@ std::wstring PracticeState::get_summary(Dictionary& dict, bool engl, bool wasCor
 
     // Find the Akkadian word's definition
     if (engl && wasCorrect) {
-        const std::vector<DictEntry>* entries = *dict.get_akk(answer);
+        std::string utf8_answer = to_utf8(answer);
+        std::span<const DictEntry> entries = *dict.get_akk(utf8_answer);
 
-        for (const DictEntry& e : *entries) {
-            if (e.grammar_kind == found_entry.grammar_kind && e.word_types == found_entry.word_types) {
+        for (const DictEntry& e : entries) {
+            if (e.grammar_kind == found_entry.grammar_kind && e.word_classes == found_entry.word_classes) {
                 found_entry = e;
-                this->word = answer;
+                this->word = utf8_answer;
                 break;
             }
         }
@@ -111,21 +147,23 @@ std::wstring PracticeState::get_summary(Dictionary& dict, bool engl, bool wasCor
 
     out += get_question() += L":\n";
 
-    for (size_t i = 0; i < found_entry.defns.size() - 1; i++) {
-        std::wstring defn = found_entry.defns[i];
-        out += defn + L", ";
+    std::span<const Symbol> defns = found_entry.defns();
+
+    for (size_t i = 0; i < defns.size() - 1; i++) {
+        out += to_wide(Akk::symbols.str(defns[i]));
+        out += L", ";
     }
 
-    out += found_entry.defns[found_entry.defns.size() - 1];
+    out += to_wide(Akk::symbols.str(defns[defns.size() - 1]));
 
     return out;
 }
 
 std::wstring PracticeState::get_question() {
-    std::wstring attrs = GRAMMAR_KINDS[entry.grammar_kind];
+    std::string attrs(GRAMMAR_KINDS[entry.grammar_kind]);
 
-    if (entry.word_types.size() != 0) {
-        attrs += L"; " + get_word_class_str(entry.word_types);
+    if (entry.word_classes != 0) {
+        attrs += "; " + get_word_class_str(entry.word_types());
     }
 
     bool is_pret_of = false;
@@ -133,7 +171,7 @@ std::wstring PracticeState::get_question() {
     bool is_acc_of = false;
     bool is_dat = false;
 
-    for (const WordRelation& w : entry.relations) {
+    for (const WordRelation& w : entry.relations()) {
         if (w.kind == WordRelationKind::PreteriteOf) {
             is_pret_of = true;
         }
@@ -149,23 +187,23 @@ std::wstring PracticeState::get_question() {
     }
 
     if (is_pret_of) {
-        attrs += L", pret";
+        attrs += ", pret";
     }
 
     if (is_gen_of && is_acc_of) {
-        attrs += L", gen-acc";
+        attrs += ", gen-acc";
     }
     else if (is_gen_of) {
-        attrs += L", gen";
+        attrs += ", gen";
     }
     else if (is_acc_of) {
-        attrs += L", acc";
+        attrs += ", acc";
     }
     else if (is_dat) {
-        attrs += L", dat";
+        attrs += ", dat";
     }
 
-    return word + L" (" + attrs + L")";
+    return to_wide(word + " (" + attrs + ")");
 }
 
 static INT_PTR CALLBACK PracticeDialog(HWND hdlg, UINT message, WPARAM w_param, LPARAM l_param, bool engl) {
@@ -178,14 +216,18 @@ static INT_PTR CALLBACK PracticeDialog(HWND hdlg, UINT message, WPARAM w_param,
     HWND answer_hwnd = GetDlgItem(hdlg, IDC_ANSWER);
     HWND your_answer_hwnd = GetDlgItem(hdlg, IDC_YOUR_ANSWER);
 
+    // The dictionary can be swapped out by a reload at any time, so this message is handled with
+    // whichever version is current when it arrives
+    std::shared_ptr<const Dictionary> dict = Akk::dict.load();
+
     switch (message) {
     case WM_INITDIALOG: {
         Edit_LimitText(answer_hwnd, MAX_ANSWER_CHARS);
         SetWindowSubclass(answer_hwnd, AkkadianEditControl, 0, NULL);
         state.reset();
-        state.new_word(Akk::dict, engl);
+        state.new_word(dict, engl);
         SetWindowTextW(word_hwnd, state.get_question().c_str());
-        SetWindowTextW(summary_hwnd, state.get_summary(Akk::dict, engl, false).c_str());
+        SetWindowTextW(summary_hwnd, state.get_summary(*dict, engl, false).c_str());
         SetWindowTextW(answer_hwnd, L"");
         SetWindowTextW(your_answer_hwnd, L"");
         return (INT_PTR)TRUE;
@@ -198,8 +240,8 @@ static INT_PTR CALLBACK PracticeDialog(HWND hdlg, UINT message, WPARAM w_param,
         else if (LOWORD(w_param) == IDOK) {
             std::wstring answer = get_input_txt(hdlg, IDC_ANSWER);
             bool correct = state.accept_answer(answer);
-            SetWindowTextW(summary_hwnd, state.get_summary(Akk::dict, engl, correct, answer).c_str());
-            state.new_word(Akk::dict, engl);
+            SetWindowTextW(summary_hwnd, state.get_summary(*dict, engl, correct, answer).c_str());
+            state.new_word(dict, engl);
             SetWindowTextW(word_hwnd, state.get_question().c_str());
             SetWindowTextW(answer_hwnd, L"");
             SetWindowTextW(your_answer_hwnd, (L"Your answer: " + answer).c_str());
@@ -211,6 +253,21 @@ static INT_PTR CALLBACK PracticeDialog(HWND hdlg, UINT message, WPARAM w_param,
     return (INT_PTR)FALSE;
 }
 
+// Posted to a lookup dialog by a worker thread when its lookup is done
+constexpr UINT WM_LOOKUP_DONE = WM_APP + 1;
+
+static void show_lookup_summary(HWND results_hwnd, std::string_view summary) {
+    if (summary.empty()) {
+        SetWindowTextW(results_hwnd, L"No results");
+        return;
+    }
+
+    std::wstring result_summary = to_wide(summary);
+    result_summary = trim(result_summary);
+
+    SetWindowTextW(results_hwnd, result_summary.c_str());
+}
+
 static INT_PTR CALLBACK LookupDialog(HWND hdlg, UINT message, WPARAM w_param, LPARAM l_param, bool engl) {
     UNREFERENCED_PARAMETER(l_param);
 
@@ -218,10 +275,33 @@ static INT_PTR CALLBACK LookupDialog(HWND hdlg, UINT message, WPARAM w_param, LP
     const static int LIMIT = 15;
 
     const static wchar_t * default_txt = LR"(
-Type a word into the box and press enter to search for definitions. Press the up arrow key
+Type a word into the box to search for definitions. Press the up arrow key
  in the box to cycle diacritical marks for the character to the left of the cursor.
     )";
 
+    // Akkadian results are shown as the query is typed. The session keeps the search state from the last
+    // keystroke, and is started over when the dialog opens or the dictionary is reloaded.
+    static std::shared_ptr<SearchSession> session;
+
+    // Every lookup runs in the background so that a slow search doesn't freeze the dialog: Akkadian ones as the
+    // query is typed go through the session, and the rest go through the cache. Starting a lookup cancels the
+    // one in flight.
+    static AsyncSearch async_lookups(Akk::search_cache, ThreadPool::shared());
+    static std::future<std::shared_ptr<const Lookup>> pending;
+
+    auto post_done = [hdlg]() {
+        PostMessageW(hdlg, WM_LOOKUP_DONE, 0, 0);
+    };
+
+    auto start_lookup = [&](const std::wstring& query) {
+        pending = async_lookups.start(Akk::dict.load(), to_utf8(query), LIMIT, CUTOFF, engl, post_done);
+    };
+
+    auto cancel_lookup = [&]() {
+        async_lookups.cancel();
+        pending = {};
+    };
+
     HWND results_hwnd = GetDlgItem(hdlg, IDC_LOOKUP_RESULTS);
     HWND input_hwnd = GetDlgItem(hdlg, IDC_LOOKUP_INPUT);
 
@@ -229,33 +309,61 @@ Type a word into the box and press enter to search for definitions. Press the up
     case WM_INITDIALOG: {
         SetWindowSubclass(input_hwnd, AkkadianEditControl, 0, NULL);
         SetWindowTextW(results_hwnd, default_txt);
+        session.reset();
+        cancel_lookup();
+        return (INT_PTR)TRUE;
+    }
+    case WM_LOOKUP_DONE: {
+        // A lookup that was replaced by a newer one could have finished first, so this only shows the results
+        // of the newest lookup once they're ready
+        if (!pending.valid() || pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return (INT_PTR)TRUE;
+        }
+
+        try {
+            show_lookup_summary(results_hwnd, pending.get()->summary);
+        } catch (const SearchCancelled&) {
+        } catch (const std::exception& err) {
+            SetWindowTextW(results_hwnd, (L"Lookup failed: " + to_wide(err.what())).c_str());
+        }
+
         return (INT_PTR)TRUE;
     }
     case WM_COMMAND: {
         if (LOWORD(w_param) == IDCANCEL) {
+            session.reset();
+            cancel_lookup();
             EndDialog(hdlg, LOWORD(w_param));
             return (INT_PTR)TRUE;
         }
-        else if (LOWORD(w_param) == IDOK) {
+        else if (LOWORD(w_param) == IDC_LOOKUP_INPUT && HIWORD(w_param) == EN_CHANGE) {
             std::wstring query = get_input_txt(hdlg, IDC_LOOKUP_INPUT);
             query = trim(query);
-            std::vector<std::wstring> results = Akk::dict.search(query, LIMIT, CUTOFF, engl);
 
-            if (results.size() == 0) {
-                SetWindowTextW(results_hwnd, L"No results");
+            if (query.empty()) {
+                cancel_lookup();
+                SetWindowTextW(results_hwnd, default_txt);
+                return (INT_PTR)TRUE;
             }
 
-            else {
-                std::wstring result_summary;
-
-                for (std::wstring& res : results) {
-                    result_summary += engl ? Akk::dict.engl_summary(res) : Akk::dict.akk_summary(res);
-                }
+            if (engl) {
+                start_lookup(query);
+                return (INT_PTR)TRUE;
+            }
 
-                result_summary = trim(result_summary);
+            std::shared_ptr<const Dictionary> dict = Akk::dict.load();
 
-                SetWindowTextW(results_hwnd, result_summary.c_str());
+            if (!session || session->get_dict() != dict) {
+                session = std::make_shared<SearchSession>(dict, LIMIT, CUTOFF, false);
             }
+
+            pending = async_lookups.start(session, to_utf8(query), post_done);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(w_param) == IDOK) {
+            std::wstring query = get_input_txt(hdlg, IDC_LOOKUP_INPUT);
+            query = trim(query);
+            start_lookup(query);
             return (INT_PTR)TRUE;
         }
         break;
@@ -279,3 +387,9 @@ INT_PTR CALLBACK LookupEnglish(HWND hdlg, UINT message, WPARAM w_param, LPARAM l
 INT_PTR CALLBACK LookupAkkadian(HWND hdlg, UINT message, WPARAM w_param, LPARAM l_param) {
     return LookupDialog(hdlg, message, w_param, l_param, false);
 }
+
+void log_unresolved(const Dictionary& dict) {
+    for (const UnresolvedRelation& rel : dict.get_unresolved()) {
+        OutputDebugStringW((to_wide(rel.message()) + L"\n").c_str());
+    }
+}
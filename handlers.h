@@ -10,16 +10,26 @@
 typedef struct PracticeState {
 	int correct{};
 	int total{};
-	std::wstring word{};
+	// UTF-8, like all dictionary text
+	std::string word{};
 	DictEntry entry{};
+	// The version of the dictionary that 'entry' came from. The entry points into it, so it has to be
+	// kept alive even if the dictionary is reloaded.
+	std::shared_ptr<const Dictionary> entry_dict{};
+	std::mt19937 rng{ std::random_device{}() };
 
 	void reset();
-	void new_word(Dictionary& dict, bool engl);
+	void new_word(std::shared_ptr<const Dictionary> dict, bool engl);
 	bool accept_answer(std::wstring& answer);
-	std::wstring get_summary(Dictionary& dict, bool engl, bool wasCorrect, std::wstring answer);
+	std::wstring get_summary(const Dictionary& dict, bool engl, bool wasCorrect, std::wstring answer);
 	std::wstring get_question();
 } PracticeState;
 
+/**
+ * Writes every unresolved relation in a dictionary to the debug output
+ */
+void log_unresolved(const Dictionary& dict);
+
 INT_PTR CALLBACK PracticeEnglish(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
 
 INT_PTR CALLBACK PracticeAkkadian(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
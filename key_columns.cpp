@@ -0,0 +1,103 @@
+#include "key_columns.h"
+#include <algorithm>
+#include <numeric>
+
+void KeyColumns::build(const FoldedKeys& words) {
+	built = false;
+	std::fill(std::begin(ascii_codes), std::end(ascii_codes), NO_CODE);
+	other_codes.clear();
+	chars.clear();
+	key_lengths.clear();
+	sorted.resize(words.size());
+	end_column.assign((words.size() + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE, END);
+
+	std::iota(sorted.begin(), sorted.end(), 0);
+	std::stable_sort(sorted.begin(), sorted.end(), [&](uint32_t lhs, uint32_t rhs) {
+		return words[lhs] < words[rhs];
+	});
+
+	size_t max_size = 0;
+	uint8_t next_code = END + 1;
+
+	for (size_t i = 0; i < words.size(); i++) {
+		std::u32string_view word = words[i];
+		max_size = (std::max)(max_size, word.size());
+
+		for (char32_t c : word) {
+			if (code(c) != NO_CODE) {
+				continue;
+			}
+
+			if (next_code == NO_CODE) {
+				return;
+			}
+
+			if (c < ASCII_SIZE) {
+				ascii_codes[c] = next_code++;
+			}
+			else {
+				other_codes.emplace(c, next_code++);
+			}
+		}
+	}
+
+	if (max_size > UINT8_MAX) {
+		return;
+	}
+
+	const size_t stride = padded_size();
+
+	chars.resize(max_size * stride, END);
+	key_lengths.resize(stride);
+
+	for (size_t i = 0; i < sorted.size(); i++) {
+		std::u32string_view word = words[sorted[i]];
+		key_lengths[i] = (uint8_t)word.size();
+
+		for (size_t j = 0; j < word.size(); j++) {
+			chars[j * stride + i] = code(word[j]);
+		}
+	}
+
+	built = true;
+}
+
+bool KeyColumns::usable() const {
+	return built;
+}
+
+uint8_t KeyColumns::code(char32_t c) const {
+	if (c < ASCII_SIZE) {
+		return ascii_codes[c];
+	}
+
+	auto it = other_codes.find(c);
+
+	return it == other_codes.end() ? NO_CODE : it->second;
+}
+
+size_t KeyColumns::size() const {
+	return sorted.size();
+}
+
+size_t KeyColumns::padded_size() const {
+	return end_column.size();
+}
+
+std::span<const uint8_t> KeyColumns::column(size_t j) const {
+	const size_t offset = j * padded_size();
+
+	if (offset >= chars.size()) {
+		return end_column;
+	}
+
+	return std::span<const uint8_t>(chars).subspan(offset, padded_size());
+}
+
+std::span<const uint8_t> KeyColumns::lengths() const {
+	return key_lengths;
+}
+
+std::span<const uint32_t> KeyColumns::positions() const {
+	return sorted;
+}
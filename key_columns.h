@@ -0,0 +1,85 @@
+/**
+ * Column-major copy of the dictionary keys, for comparing one char against every key at once.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "letters.h"
+
+/**
+ * A list of folded keys (see letters.h) stored one char position at a time: column j has char j of every key,
+ * one byte per key. Each distinct char gets a one-byte code, so a loop over a column compares a char against many
+ * keys with a few vector instructions. The keys are sorted by their text, so keys that start the same way are
+ * next to each other. Each column is padded with END to a multiple of BLOCK_SIZE keys, so that a loop over a block
+ * of keys always has the same number of steps.
+ *
+ * If the keys have too many distinct chars or are too long for one-byte codes and lengths, the columns aren't
+ * built and usable() is false.
+ *
+ * The columns are built once and then only read, so they can be used from any number of threads at once.
+ */
+typedef struct KeyColumns {
+	// The code past the end of a key
+	static constexpr uint8_t END = 0;
+	// The code of a char that no key has
+	static constexpr uint8_t NO_CODE = UINT8_MAX;
+	static const size_t BLOCK_SIZE = 64;
+
+	/**
+	 * Builds the columns for a list of folded keys. Any previous contents are replaced.
+	 */
+	void build(const FoldedKeys& words);
+
+	bool usable() const;
+
+	/**
+	 * Returns the code of a char, or NO_CODE if no key has it
+	 */
+	uint8_t code(char32_t c) const;
+
+	/**
+	 * Returns the number of keys
+	 */
+	size_t size() const;
+
+	/**
+	 * Returns the number of keys rounded up to a multiple of BLOCK_SIZE
+	 */
+	size_t padded_size() const;
+
+	/**
+	 * Returns char j of every key, in sorted order, and then END for the padding. Keys with at most j chars
+	 * have END.
+	 */
+	std::span<const uint8_t> column(size_t j) const;
+
+	/**
+	 * Returns the length of every key, in sorted order, and then 0 for the padding
+	 */
+	std::span<const uint8_t> lengths() const;
+
+	/**
+	 * Returns the position of every key in the list the columns were built from, in sorted order
+	 */
+	std::span<const uint32_t> positions() const;
+
+private:
+	// Codes of the ASCII chars are looked up directly, and the rest are hashed
+	static const size_t ASCII_SIZE = 128;
+
+	bool built{};
+	uint8_t ascii_codes[ASCII_SIZE]{};
+	std::unordered_map<char32_t, uint8_t> other_codes{};
+	// Column j is chars[j * padded_size(), (j + 1) * padded_size()), and every column after the last one is
+	// all END
+	std::vector<uint8_t> chars{};
+	std::vector<uint8_t> key_lengths{};
+	std::vector<uint32_t> sorted{};
+	// A column of END codes
+	std::vector<uint8_t> end_column{};
+} KeyColumns;
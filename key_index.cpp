@@ -0,0 +1,123 @@
+#include "key_index.h"
+#include <functional>
+
+void KeyIndex::build(std::span<const Symbol> keys) {
+	// The table is kept at most half full so that probe sequences stay short
+	size_t capacity = MIN_CAPACITY;
+
+	while (capacity < keys.size() * 2) {
+		capacity *= 2;
+	}
+
+	slots.assign(capacity, Slot{});
+	mask = capacity - 1;
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		std::string_view word = Akk::symbols.str(keys[i]);
+		uint32_t hash = hash_word(word);
+		size_t j = hash & mask;
+
+		while (slots[j].pos != EMPTY) {
+			j = (j + 1) & mask;
+		}
+
+		slots[j] = Slot{ word.data(), (uint32_t)word.size(), hash, (uint32_t)i };
+	}
+}
+
+int KeyIndex::find(std::string_view word) const {
+	if (slots.empty()) {
+		return -1;
+	}
+
+	uint32_t hash = hash_word(word);
+
+	for (size_t j = hash & mask; slots[j].pos != EMPTY; j = (j + 1) & mask) {
+		const Slot& slot = slots[j];
+
+		if (slot.hash == hash && std::string_view(slot.text, slot.size) == word) {
+			return (int)slot.pos;
+		}
+	}
+
+	return -1;
+}
+
+std::vector<uint32_t> KeyIndex::slot_positions() const {
+	std::vector<uint32_t> out(slots.size());
+
+	for (size_t j = 0; j < slots.size(); j++) {
+		out[j] = slots[j].pos;
+	}
+
+	return out;
+}
+
+std::vector<uint32_t> KeyIndex::slot_hashes() const {
+	std::vector<uint32_t> out(slots.size());
+
+	for (size_t j = 0; j < slots.size(); j++) {
+		out[j] = slots[j].hash;
+	}
+
+	return out;
+}
+
+bool KeyIndex::restore(std::span<const Symbol> keys, const std::vector<uint32_t>& positions, const std::vector<uint32_t>& hashes) {
+	const size_t capacity = positions.size();
+	std::vector<bool> seen(keys.size());
+	size_t num_keys = 0;
+	bool hash_checked = false;
+
+	slots.clear();
+	mask = 0;
+
+	if (capacity < MIN_CAPACITY || (capacity & (capacity - 1)) || capacity < keys.size() * 2 || hashes.size() != capacity) {
+		return false;
+	}
+
+	slots.resize(capacity);
+
+	for (size_t j = 0; j < capacity; j++) {
+		const uint32_t pos = positions[j];
+
+		if (pos == EMPTY) {
+			continue;
+		}
+
+		if (pos >= keys.size() || seen[pos]) {
+			slots.clear();
+			return false;
+		}
+
+		std::string_view word = Akk::symbols.str(keys[pos]);
+
+		// The hash function could be different in the program that stored the index. Checking one key is
+		// enough to tell.
+		if (!hash_checked) {
+			if (hash_word(word) != hashes[j]) {
+				slots.clear();
+				return false;
+			}
+
+			hash_checked = true;
+		}
+
+		seen[pos] = true;
+		num_keys++;
+		slots[j] = Slot{ word.data(), (uint32_t)word.size(), hashes[j], pos };
+	}
+
+	if (num_keys != keys.size()) {
+		slots.clear();
+		return false;
+	}
+
+	mask = capacity - 1;
+
+	return true;
+}
+
+uint32_t KeyIndex::hash_word(std::string_view word) {
+	return (uint32_t)std::hash<std::string_view>()(word);
+}
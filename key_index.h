@@ -0,0 +1,60 @@
+/**
+ * Hash index for looking up dictionary keys by text.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "symbols.h"
+
+/**
+ * An open-addressing hash table from the text of a key to its position in a vector of keys. Slots hold the
+ * hash and a view of the text, so a lookup is one linear probe through a flat array with no locks and no
+ * other memory touched except the text of a matching key. The index is built once and then only read.
+ */
+typedef struct KeyIndex {
+	/**
+	 * Builds the index for a vector of unique keys. Any previous contents are replaced.
+	 */
+	void build(std::span<const Symbol> keys);
+
+	/**
+	 * Returns the position of a word in the keys the index was built from, or -1 if it isn't a key.
+	 */
+	int find(std::string_view word) const;
+
+	/**
+	 * Returns the position of the key in each slot, or EMPTY for an empty slot. A snapshot stores these with the
+	 * hashes so that the index can be restored without hashing every key again (see snapshot.cpp).
+	 */
+	std::vector<uint32_t> slot_positions() const;
+	std::vector<uint32_t> slot_hashes() const;
+
+	/**
+	 * Restores the index that slot_positions and slot_hashes came from. 'keys' must be the same keys, but they
+	 * can be different symbols with the same text. Returns false and leaves the index empty if the slots can't be
+	 * an index of the keys.
+	 */
+	bool restore(std::span<const Symbol> keys, const std::vector<uint32_t>& positions, const std::vector<uint32_t>& hashes);
+
+	static const uint32_t EMPTY = UINT32_MAX;
+
+private:
+	static const size_t MIN_CAPACITY = 16;
+
+	typedef struct Slot {
+		const char* text{};
+		uint32_t size{};
+		uint32_t hash{};
+		uint32_t pos{ EMPTY };
+	} Slot;
+
+	std::vector<Slot> slots{};
+	size_t mask{};
+
+	static uint32_t hash_word(std::string_view word);
+} KeyIndex;
@@ -0,0 +1,128 @@
+#include "letters.h"
+#include <array>
+
+// Every letter in LETTER_GROUPS is below this, so folding a char is one lookup in FOLD_TABLE
+const size_t FOLD_TABLE_SIZE = 0x2000;
+
+static constexpr bool letters_fit_table() {
+	for (std::u32string_view group : LETTER_GROUPS) {
+		for (char32_t c : group) {
+			if (c >= FOLD_TABLE_SIZE) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static_assert(letters_fit_table(), "FOLD_TABLE_SIZE is too small for LETTER_GROUPS");
+
+// FOLD_TABLE[c] is the base letter for c
+static constexpr std::array<char32_t, FOLD_TABLE_SIZE> FOLD_TABLE = [] {
+	std::array<char32_t, FOLD_TABLE_SIZE> out{};
+
+	for (size_t c = 0; c < out.size(); c++) {
+		out[c] = (char32_t)c;
+	}
+
+	for (std::u32string_view group : LETTER_GROUPS) {
+		for (char32_t c : group) {
+			out[c] = group[0];
+		}
+	}
+
+	return out;
+}();
+
+/**
+ * Reads the code point that starts at s[pos] and moves pos past it. Dictionary text is
+ * UTF-8 and comes from our own file, so the sequence is assumed to be well formed.
+ */
+static char32_t next_char(std::string_view s, size_t& pos) {
+	const unsigned char lead = (unsigned char)s[pos++];
+
+	if (lead < 0x80) {
+		return lead;
+	}
+
+	const int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : 1;
+	char32_t out = lead & (0x3F >> extra);
+
+	for (int i = 0; i < extra && pos < s.size(); i++) {
+		out = (out << 6) | ((unsigned char)s[pos++] & 0x3F);
+	}
+
+	return out;
+}
+
+char32_t fold_char(char32_t c) {
+	return c < FOLD_TABLE_SIZE ? FOLD_TABLE[c] : c;
+}
+
+std::u32string fold_word(std::string_view word) {
+	std::u32string out;
+	size_t pos = 0;
+
+	while (pos < word.size()) {
+		out.push_back(fold_char(next_char(word, pos)));
+	}
+
+	return out;
+}
+
+void FoldedKeys::build(std::span<const Symbol> keys) {
+	text.clear();
+	offsets.clear();
+	offsets.reserve(keys.size() + 1);
+	offsets.push_back(0);
+
+	for (Symbol sym : keys) {
+		std::string_view word = Akk::symbols.str(sym);
+		size_t pos = 0;
+
+		while (pos < word.size()) {
+			text.push_back(fold_char(next_char(word, pos)));
+		}
+
+		offsets.push_back((uint32_t)text.size());
+	}
+
+	text.shrink_to_fit();
+}
+
+std::u32string_view FoldedKeys::operator[](size_t pos) const {
+	return std::u32string_view(text).substr(offsets[pos], offsets[pos + 1] - offsets[pos]);
+}
+
+size_t FoldedKeys::size() const {
+	return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+const std::u32string& FoldedKeys::get_text() const {
+	return text;
+}
+
+const std::vector<uint32_t>& FoldedKeys::get_offsets() const {
+	return offsets;
+}
+
+bool FoldedKeys::restore(size_t num_keys, std::u32string new_text, std::vector<uint32_t> new_offsets) {
+	text.clear();
+	offsets.clear();
+
+	if (new_offsets.size() != num_keys + 1 || new_offsets.front() != 0 || new_offsets.back() != new_text.size()) {
+		return false;
+	}
+
+	for (size_t i = 1; i < new_offsets.size(); i++) {
+		if (new_offsets[i] < new_offsets[i - 1]) {
+			return false;
+		}
+	}
+
+	text = std::move(new_text);
+	offsets = std::move(new_offsets);
+
+	return true;
+}
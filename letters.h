@@ -0,0 +1,75 @@
+﻿/**
+ * The letters with diacritical marks, and folding text down to the base letters so that it can be compared
+ * without the marks.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "symbols.h"
+
+/**
+ * The letters that can have diacritical marks, grouped with their marked forms. These are the letters in the
+ * alphabet given in Huehnergard's book. The first letter in each group is the base letter. The Akkadian edit
+ * control cycles through each group in this order (see components.h).
+ */
+constexpr std::u32string_view LETTER_GROUPS[] = {
+	U"sšṣ",
+	U"tṭ",
+	U"aāâ",
+	U"eēê",
+	U"iīî",
+	U"uūû",
+	U"hḫ"
+};
+
+/**
+ * Removes the diacritical marks from a char, so that 'š' and 'ṣ' become 's', 'ā' and 'â' become 'a', and so on.
+ */
+char32_t fold_char(char32_t c);
+
+/**
+ * Decodes a UTF-8 word and folds every char
+ */
+std::u32string fold_word(std::string_view word);
+
+/**
+ * A list of keys with their diacritical marks folded. The folded keys are stored back to back in one array, so
+ * that comparing a query to every key is a pass over contiguous memory with plain char equality.
+ */
+typedef struct FoldedKeys {
+	/**
+	 * Folds a list of keys. Any previous contents are replaced.
+	 */
+	void build(std::span<const Symbol> keys);
+
+	/**
+	 * Returns the folded key at position 'pos' in the keys the list was built from
+	 */
+	std::u32string_view operator[](size_t pos) const;
+
+	size_t size() const;
+
+	/**
+	 * Returns the folded keys back to back and where each one starts, so that they can be stored in a snapshot
+	 * (see snapshot.cpp)
+	 */
+	const std::u32string& get_text() const;
+	const std::vector<uint32_t>& get_offsets() const;
+
+	/**
+	 * Restores a list of 'num_keys' folded keys from get_text and get_offsets, without folding them again.
+	 * Returns false and leaves the list empty if the offsets don't fit the text.
+	 */
+	bool restore(size_t num_keys, std::u32string text, std::vector<uint32_t> offsets);
+
+private:
+	std::u32string text{};
+	// Key i is text[offsets[i], offsets[i + 1])
+	std::vector<uint32_t> offsets{};
+} FoldedKeys;
@@ -0,0 +1,91 @@
+#include "prefix_index.h"
+#include <algorithm>
+#include <numeric>
+
+void PrefixIndex::build(const FoldedKeys& words) {
+	sorted.resize(words.size());
+	tops.clear();
+	top_lists.clear();
+
+	std::iota(sorted.begin(), sorted.end(), 0);
+	std::stable_sort(sorted.begin(), sorted.end(), [&](uint32_t lhs, uint32_t rhs) {
+		return words[lhs] < words[rhs];
+	});
+
+	std::vector<Range> stack = { Range{ 0, (uint32_t)sorted.size(), 0 } };
+
+	while (!stack.empty()) {
+		const Range range = stack.back();
+		stack.pop_back();
+
+		if (range.end - range.begin <= MIN_LISTED_RANGE) {
+			continue;
+		}
+
+		// A longer prefix can have the same range as a shorter one, and then it has the same list
+		const uint64_t key = (uint64_t)range.begin << 32 | range.end;
+
+		if (top_lists.emplace(key, (uint32_t)tops.size()).second) {
+			shortest(words, std::span<const uint32_t>(sorted).subspan(range.begin, range.end - range.begin), TOP_SIZE, tops);
+		}
+
+		// The words that are only the prefix come first, and then the ranges of the longer prefixes
+		uint32_t i = range.begin;
+
+		while (i < range.end && words[sorted[i]].size() == range.depth) {
+			i++;
+		}
+
+		while (i < range.end) {
+			const char32_t c = words[sorted[i]][range.depth];
+			uint32_t j = i + 1;
+
+			while (j < range.end && words[sorted[j]][range.depth] == c) {
+				j++;
+			}
+
+			stack.push_back(Range{ i, j, range.depth + 1 });
+			i = j;
+		}
+	}
+}
+
+void PrefixIndex::find(const FoldedKeys& words, std::u32string_view prefix, size_t limit, std::vector<uint32_t>& out) const {
+	auto begin = std::partition_point(sorted.begin(), sorted.end(), [&](uint32_t pos) {
+		return words[pos].substr(0, prefix.size()) < prefix;
+	});
+	auto end = std::partition_point(begin, sorted.end(), [&](uint32_t pos) {
+		return words[pos].substr(0, prefix.size()) == prefix;
+	});
+
+	const size_t range_begin = begin - sorted.begin();
+	const size_t range_end = end - sorted.begin();
+
+	if (limit <= TOP_SIZE && range_end - range_begin > MIN_LISTED_RANGE) {
+		auto it = top_lists.find((uint64_t)range_begin << 32 | range_end);
+
+		if (it != top_lists.end()) {
+			out.insert(out.end(), tops.begin() + it->second, tops.begin() + it->second + limit);
+			return;
+		}
+	}
+
+	shortest(words, std::span<const uint32_t>(begin, end), limit, out);
+}
+
+/**
+ * Appends the positions of the shortest 'limit' words to 'out', shortest first and then in order of position
+ */
+void PrefixIndex::shortest(const FoldedKeys& words, std::span<const uint32_t> positions, size_t limit, std::vector<uint32_t>& out) {
+	std::vector<uint32_t> items(positions.begin(), positions.end());
+	const size_t count = (std::min)(limit, items.size());
+
+	std::partial_sort(items.begin(), items.begin() + count, items.end(), [&](uint32_t lhs, uint32_t rhs) {
+		const size_t lhs_size = words[lhs].size();
+		const size_t rhs_size = words[rhs].size();
+
+		return lhs_size < rhs_size || (lhs_size == rhs_size && lhs < rhs);
+	});
+
+	out.insert(out.end(), items.begin(), items.begin() + count);
+}
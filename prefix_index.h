@@ -0,0 +1,56 @@
+/**
+ * Index for finding the shortest keys that start with a prefix.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "letters.h"
+
+/**
+ * The positions of a list of folded keys (see letters.h), sorted by their text. The keys that start with a prefix
+ * are a range in the sorted list, which is found with a binary search. A search wants the shortest few keys in
+ * the range, so for every range bigger than MIN_LISTED_RANGE (the ranges of the short prefixes that match a lot of
+ * keys), the shortest TOP_SIZE keys are worked out when the index is built. Every other range is small enough to
+ * sort. A search with a limit of at most TOP_SIZE takes about the same time no matter how many keys there are.
+ *
+ * The index is built once and then only read, so it can be searched from any number of threads at once.
+ */
+typedef struct PrefixIndex {
+	/**
+	 * Builds the index for a list of folded keys. Any previous contents are replaced.
+	 */
+	void build(const FoldedKeys& words);
+
+	/**
+	 * Finds the shortest 'limit' words that start with 'prefix' and appends their positions to 'out', shortest
+	 * first. Words with the same length are in the order of their positions. 'words' must be the list the index was
+	 * built from.
+	 */
+	void find(const FoldedKeys& words, std::u32string_view prefix, size_t limit, std::vector<uint32_t>& out) const;
+
+private:
+	static const size_t TOP_SIZE = 16;
+	static const size_t MIN_LISTED_RANGE = 256;
+
+	typedef struct Range {
+		uint32_t begin{};
+		uint32_t end{};
+		// Every word in the range has the same first 'depth' chars
+		uint32_t depth{};
+	} Range;
+
+	// Positions of the words, sorted by text
+	std::vector<uint32_t> sorted{};
+	// The shortest words in each listed range, back to back. A range [begin, end) is keyed by begin << 32 | end,
+	// and its list is the next min(TOP_SIZE, end - begin) positions from the offset it maps to.
+	std::vector<uint32_t> tops{};
+	std::unordered_map<uint64_t, uint32_t> top_lists{};
+
+	static void shortest(const FoldedKeys& words, std::span<const uint32_t> positions, size_t limit, std::vector<uint32_t>& out);
+} PrefixIndex;
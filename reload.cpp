@@ -0,0 +1,180 @@
+#include "common.h"
+#include <assert.h>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <span>
+#include "errors.h"
+#include "reload.h"
+
+// Editors often write a file in several steps, so wait this long after a change before reading the file
+const DWORD RELOAD_DELAY_MS = 200;
+
+DictSource::DictSource(std::wstring& filename) : text(read_dict_file(filename)) {
+	lines = split_dict_lines(text);
+	parsed = parse_dict_text(text);
+}
+
+bool DictSource::update(std::wstring& filename, std::vector<ParsedLine>& removed, size_t& added_begin, size_t& added_end) {
+	std::string new_text = read_dict_file(filename);
+	std::vector<std::string_view> new_lines = split_dict_lines(new_text);
+
+	size_t common = (std::min)(lines.size(), new_lines.size());
+	size_t prefix = 0;
+	size_t suffix = 0;
+
+	while (prefix < common && lines[prefix] == new_lines[prefix]) {
+		prefix++;
+	}
+
+	while (suffix < common - prefix && lines[lines.size() - 1 - suffix] == new_lines[new_lines.size() - 1 - suffix]) {
+		suffix++;
+	}
+
+	if (prefix == lines.size() && prefix == new_lines.size()) {
+		return false;
+	}
+
+	const size_t old_end = lines.size() - suffix;
+	const size_t new_end = new_lines.size() - suffix;
+	std::vector<ParsedLine> changed;
+
+	// Each line is parsed on its own, the same way as a fresh load, so that an empty line is an error even at the
+	// end of the changed block
+	for (size_t i = prefix; i < new_end; i++) {
+		changed.push_back(parse_dict_line(new_lines[i], (int)i + 1));
+	}
+
+	assert(changed.size() == new_end - prefix);
+
+	removed.assign(
+		std::make_move_iterator(parsed.begin() + prefix),
+		std::make_move_iterator(parsed.begin() + old_end)
+	);
+	parsed.erase(parsed.begin() + prefix, parsed.begin() + old_end);
+	parsed.insert(
+		parsed.begin() + prefix,
+		std::make_move_iterator(changed.begin()),
+		std::make_move_iterator(changed.end())
+	);
+
+	// Moving a short string can copy it, so the views have to be recreated
+	text = std::move(new_text);
+	lines = split_dict_lines(text);
+
+	added_begin = prefix;
+	added_end = new_end;
+
+	return true;
+}
+
+const std::vector<ParsedLine>& DictSource::get_parsed() const {
+	return parsed;
+}
+
+DictReloader::DictReloader(std::wstring filename, std::wstring snapshot_filename, FileStamp loaded_stamp) :
+	filename(filename), snapshot_filename(snapshot_filename), loaded_stamp(loaded_stamp) {
+	stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	watcher = std::thread(&DictReloader::watch, this);
+}
+
+DictReloader::~DictReloader() {
+	SetEvent(stop_event);
+	watcher.join();
+	CloseHandle(stop_event);
+}
+
+void DictReloader::watch() {
+	std::wstring directory = std::filesystem::path(filename).parent_path().wstring();
+
+	if (directory.empty()) {
+		directory = L".";
+	}
+
+	HANDLE change = FindFirstChangeNotificationW(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+
+	if (change == INVALID_HANDLE_VALUE) {
+		OutputDebugStringW((L"Failed to watch directory for changes: " + directory + L"\n").c_str());
+		return;
+	}
+
+	std::optional<DictSource> source;
+
+	// The source is parsed here rather than when the dictionary was first loaded, because the first load
+	// might have come from a snapshot. The directory is already being watched, so a change after this is
+	// always reloaded.
+	try {
+		source.emplace(filename);
+
+		// The file could have changed between the first load and reading the source. Updates are made by
+		// comparing with the source, so the dictionary has to be built from the same version of the file. The
+		// stamp is taken after the source is read, so that a change while it was being read counts too.
+		FileStamp stamp;
+
+		if (!file_stamp(filename, stamp) || stamp != loaded_stamp) {
+			Akk::dict.store(std::make_shared<const Dictionary>(source->get_parsed()));
+			OutputDebugStringA("Dictionary changed since it was loaded; built it again\n");
+		}
+	} catch (DictParseError err) {
+		OutputDebugStringW((L"Failed to read dictionary for reloading. " + err.message() + L"\n").c_str());
+	}
+
+	HANDLE handles[] = { stop_event, change };
+
+	while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+		if (WaitForSingleObject(stop_event, RELOAD_DELAY_MS) == WAIT_OBJECT_0) {
+			break;
+		}
+
+		FindNextChangeNotification(change);
+		reload(source);
+	}
+
+	FindCloseChangeNotification(change);
+}
+
+void DictReloader::reload(std::optional<DictSource>& source) {
+	// The stamp is taken before the file is read, so that the snapshot is stale if the file changes again while
+	// it's being read
+	FileStamp stamp;
+	const bool stamped = file_stamp(filename, stamp);
+
+	try {
+		if (!source.has_value()) {
+			source.emplace(filename);
+			Akk::dict.store(std::make_shared<const Dictionary>(source->get_parsed()));
+		} else {
+			std::vector<ParsedLine> removed;
+			size_t added_begin;
+			size_t added_end;
+
+			if (!source->update(filename, removed, added_begin, added_end)) {
+				return;
+			}
+
+			std::span<const ParsedLine> added(source->get_parsed().data() + added_begin, added_end - added_begin);
+
+			// This is the only thread that stores to Akk::dict after startup, and the watcher made the first
+			// version match the source, so the current version is the one that was built from the previous
+			// version of the source
+			Akk::dict.store(Akk::dict.load()->patch(source->get_parsed(), removed, added));
+
+			std::string debug_msg = "Reloaded dictionary: " + std::to_string(removed.size()) + " lines removed, " +
+				std::to_string(added.size()) + " lines added, " +
+				std::to_string(Akk::dict.load()->get_unresolved().size()) + " unresolved relations\n";
+
+			OutputDebugStringA(debug_msg.c_str());
+		}
+	} catch (DictParseError err) {
+		OutputDebugStringW((L"Failed to reload dictionary. " + err.message() + L"\n").c_str());
+		return;
+	}
+
+	if (!stamped) {
+		return;
+	}
+
+	if (!Akk::dict.load()->save_snapshot(snapshot_filename, stamp)) {
+		OutputDebugStringW((L"Failed to write dictionary snapshot: " + snapshot_filename + L"\n").c_str());
+	}
+}
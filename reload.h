@@ -0,0 +1,77 @@
+/**
+ * Hot reloading of the dictionary file. When the file changes while the program is running, only the lines
+ * that changed are parsed again, and a patched copy of the dictionary is swapped in for Akk::dict.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+#include "common.h"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "dict.h"
+
+/**
+ * The text and parsed lines of a dictionary file. This is kept between reloads so that a new version
+ * of the file can be compared to the old one.
+ */
+typedef struct DictSource {
+	/**
+	 * Reads and parses the whole file.
+	 */
+	DictSource(std::wstring& filename);
+
+	DictSource(const DictSource&) = delete;
+	DictSource& operator=(const DictSource&) = delete;
+
+	/**
+	 * Reads the file again and parses the lines that changed. Lines at the start and end of the file that
+	 * are the same as before are not parsed again. The lines that were replaced are moved into 'removed', and
+	 * the new lines are parsed[added_begin, added_end). Returns false if nothing changed.
+	 *
+	 * If the new version of the file can't be parsed, a DictParseError is thrown and nothing is modified.
+	 */
+	bool update(std::wstring& filename, std::vector<ParsedLine>& removed, size_t& added_begin, size_t& added_end);
+
+	const std::vector<ParsedLine>& get_parsed() const;
+
+private:
+	std::string text{};
+	// Views into 'text'
+	std::vector<std::string_view> lines{};
+	std::vector<ParsedLine> parsed{};
+} DictSource;
+
+/**
+ * Watches the dictionary file on a background thread and publishes a new version of Akk::dict whenever the
+ * file changes. Readers are never blocked; they keep using the version they loaded until they're done with it.
+ * If the file has errors after a change, the current dictionary is kept and the error is written to the
+ * debug output.
+ */
+typedef struct DictReloader {
+	/**
+	 * 'loaded_stamp' is the stamp of the file that the current version of Akk::dict was loaded from (see
+	 * Dictionary::load). If the file has changed since then, the dictionary is built again when the watcher starts.
+	 */
+	DictReloader(std::wstring filename, std::wstring snapshot_filename, FileStamp loaded_stamp);
+
+	DictReloader(const DictReloader&) = delete;
+	DictReloader& operator=(const DictReloader&) = delete;
+
+	/**
+	 * Stops watching the file and waits for a reload in progress to finish.
+	 */
+	~DictReloader();
+
+private:
+	std::wstring filename{};
+	std::wstring snapshot_filename{};
+	FileStamp loaded_stamp{};
+	HANDLE stop_event{};
+	std::thread watcher{};
+
+	void watch();
+	void reload(std::optional<DictSource>& source);
+} DictReloader;
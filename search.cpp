@@ -4,7 +4,8 @@
  * When looking up an English word, every English entry is searched for the literal query. 
  * If a word contains the query, it is added to a list of candidate results. 
  * The candidates are sorted in ascending order by word length and the first N 
- * candidates are the results.
+ * candidates are the results. Candidates with the same length stay in alphabetical order.
+ * The candidates are found with a suffix array (see suffix_array.h).
  * 
  * When looking up an Akkadian word, the length of the query is compared to a "cutoff." If
  * the query is shorter than the cutoff, then search method 1 is used, otherwise search method 2.
@@ -12,14 +13,26 @@
  * 1: Every Akkadian entry that is shorter than the query is discarded. The Akkadian entries
  * that start with the query string are the candidates. To determine if an entry starts with
  * the query string, diacritical marks are ignored. The candidates are sorted by string length
- * and the first N candidates are the results.
+ * and the first N candidates are the results. Candidates with the same length stay in alphabetical
+ * order. The candidates are a range of a sorted index, and the shortest ones are precomputed
+ * for big ranges (see prefix_index.h).
  * 
  * 2. The Levenshtein distance between every Akkadian entry and the query string is calculated.
  * In calculating this distance, the diacritical marks are significant. If the query string
  * and the entry are the same length, then the Hamming distance is calculated, ignoring
  * diacritical marks. The lower distance is compared to the cutoff. If the distance is
  * less than or equal to the cutoff, then the entry is a candidate. The candidates are sorted
- * by their distance (Levenshtein or Hamming), and the first N are the results.
+ * by their distance (Levenshtein or Hamming), and the first N are the results. Candidates with the
+ * same distance stay in alphabetical order.
+ * Rather than calculating the distance to every entry, the entries close enough by Levenshtein
+ * distance are found with a BK-tree (see bk_tree.h), and the entries that could be close enough
+ * by Hamming distance are found by comparing the start of each entry to the query. Alternatively,
+ * both kinds of match can be found in one walk of a word graph of the entries (see dawg.h).
+ * Only the best N candidates seen so far are kept (see TopScores in edit_distance.h), so once there
+ * are N of them, the worst one's distance is the new cutoff. Entries are skipped if their length
+ * alone is too far from the query's, and the Levenshtein distance is computed with a bit-parallel
+ * kernel that stops once the rest of the entry can't bring it back under the cutoff (see LevPattern
+ * in edit_distance.h). The word graph only computes the cells of each row near the diagonal.
  * 
  * ==========================================================================================
  * 
@@ -32,222 +45,467 @@
  */
 #include "common.h"
 #include "dict.h"
+#include "edit_distance.h"
+#include "errors.h"
+#include "letters.h"
+#include "thread_pool.h"
+
+// Keys in each shard of a parallel fuzzy search. The folded text of this many keys is around 128 KB, so a shard
+// stays in L2 cache while it's scanned.
+const size_t FUZZY_SHARD_SIZE = 4096;
+// Shards per thread of a parallel search of the word graph. Every shard walks the graph from the root, so there
+// are only enough of them to keep the threads busy.
+const size_t GRAPH_SHARDS_PER_THREAD = 4;
+// Queries in each block of a batch fuzzy search. Every key is checked against a whole block of queries while it's
+// in cache.
+const size_t BATCH_BLOCK_SIZE = 32;
+// Keys scanned between checks for a cancelled search
+const uint32_t CANCEL_CHECK_INTERVAL = 1024;
 
 /**
- * Returns true if the chars are equal when diacritical marks are removed.
- * This makes it possible to search for an 's' and get results with 'š'
- * and 'ṣ'.
+ * Returns the number of code points in a UTF-8 string. Lengths are compared in characters,
+ * not bytes, so that 'š' counts the same as 's'.
  */
-static bool cmp_chars(wchar_t a, wchar_t b) {
-	switch (a) {
-	case L'š':
-	case L'ṣ':
-	case L's':
-		return b == L's' || b == L'š' || b == L'ṣ';
-	case L't':
-	case L'ṭ':
-		return b == L't' || b == L'ṭ';
-	case L'h':
-	case L'ḫ':
-		return b == L'h' || b == L'ḫ';
-	case L'a':
-	case L'ā':
-	case L'â':
-		return b == L'a' || b == L'ā' || b == L'â';
-	case L'e':
-	case L'ē':
-	case L'ê':
-		return b == L'e' || b == L'ē' || b == L'ê';
-	case L'i':
-	case L'ī':
-	case L'î':
-		return b == L'i' || b == L'ī' || b == L'î';
-	case L'u':
-	case L'ū':
-	case L'û':
-		return b == L'u' || b == L'ū' || b == L'û';
+static size_t char_count(std::string_view s) {
+	size_t out = 0;
+
+	for (char c : s) {
+		if (((unsigned char)c & 0xC0) != 0x80) {
+			out++;
+		}
 	}
 
-	return a == b;
+	return out;
 }
 
-static bool akk_starts_with(const std::wstring& s, const std::wstring& sub) {
-	if (s.size() < sub.size()) {
-		return false;
-	}
+/**
+ * Hamming distance between 's' and the start of 't', which must be at least as long. Both strings
+ * are folded (see letters.h), so diacritical marks are ignored by comparing chars exactly.
+ */
+static int hamming_dist(std::u32string_view s, std::u32string_view t) {
+	int out = 0;
 
-	for (size_t i = 0; i < sub.size(); i++) {
-		if (!cmp_chars(sub[i], s[i])) {
-			return false;
-		}
+	for (size_t i = 0; i < s.size(); i++) {
+		out += s[i] != t[i];
 	}
 
-	return true;
+	return out;
+}
+
+/**
+ * The fuzzy search's scan of the keys for one query, in order of position
+ */
+typedef struct KeyScan {
+	std::u32string_view query{};
+	// The query prepared for the bit-parallel kernel, which is faster than the banded DP for queries of up to
+	// 64 chars and falls back to it for longer ones
+	LevPattern pattern;
+	int cutoff{};
+	// Sorted positions of the keys found by the BK-tree, from the next key to be scanned on
+	std::span<const uint32_t> tree_matches{};
+	TopScores top;
+	size_t cells{};
+} KeyScan;
+
+/**
+ * Starts a scan of the keys from position 'begin' on
+ */
+static KeyScan start_scan(
+	std::u32string_view query,
+	int cutoff,
+	std::span<const uint32_t> tree_matches,
+	uint32_t begin,
+	size_t limit
+) {
+	auto first_match = std::lower_bound(tree_matches.begin(), tree_matches.end(), begin);
+
+	return KeyScan{
+		query,
+		LevPattern(query),
+		cutoff,
+		tree_matches.subspan(first_match - tree_matches.begin()),
+		TopScores(limit)
+	};
 }
 
 /**
- * Levenshtein distance: a metric for comparing strings that does not require the strings
- * to have the same length. Algorithm adapted from 
- * https://www.codeproject.com/Articles/13525/Fast-memory-efficient-Levenshtein-algorithm-2.
+ * Scores the next key of a scan and adds it to the scan's results if it's within the cutoff. The key is only
+ * scored if the BK-tree found it or if it's close enough to the query by Hamming distance.
  */
-static int lev_dist(const std::wstring& s, const std::wstring& t) {
-	int n = (int)s.size();
-	int m = (int)t.size();
-	int row_idx;
-	int col_idx;
-	wchar_t row_i;
-	wchar_t col_j;
-	int cost;
+static void scan_key(KeyScan& scan, uint32_t pos, std::u32string_view word) {
+	const std::u32string_view query = scan.query;
+	const bool tree_match = !scan.tree_matches.empty() && scan.tree_matches.front() == pos;
+	// The highest distance that could still make it into the results
+	const int max_dist = (std::min)(scan.cutoff, scan.top.max_score());
+	int dist = max_dist + 1;
+
+	if (tree_match) {
+		scan.tree_matches = scan.tree_matches.subspan(1);
+	}
 
-	if (n == 0) {
-		return m;
+	// Prioritize substitutions at the start of the word
+	if (query.size() <= word.size()) {
+		dist = (std::min)(dist, hamming_dist(query, word));
 	}
 
-	if (m == 0) {
-		return n;
+	if (!tree_match && dist > max_dist) {
+		return;
 	}
 
-	std::vector<int> v0(n + 1);
-	std::vector<int> v1(n + 1);
-	std::vector<int> v_tmp;
+	// The Levenshtein distance only matters if it's lower. It's at least the difference in length,
+	// so most words don't need it at all.
+	const int max_lev = dist - 1;
+	const int size_diff = std::abs((int)query.size() - (int)word.size());
 
-	for (row_idx = 1; row_idx <= n; row_idx++) {
-		v0[row_idx] = row_idx;
+	if (size_diff <= max_lev) {
+		dist = (std::min)(dist, scan.pattern.distance_within(word, max_lev, scan.cells));
 	}
 
-	for (col_idx = 1; col_idx <= m; col_idx++) {
-		v1[0] = col_idx;
-		col_j = t[col_idx - 1];
+	if (dist <= max_dist) {
+		scan.top.add(dist, pos);
+	}
+}
 
-		for (row_idx = 1; row_idx <= n; row_idx++) {
-			row_i = s[row_idx - 1];
+std::vector<std::string> Dictionary::search(
+	std::string_view query,
+	size_t limit,
+	int cutoff,
+	bool engl,
+	FuzzyIndex fuzzy_index,
+	SearchStats* stats,
+	ThreadPool* thread_pool,
+	std::stop_token stop
+) const {
+	if (engl) {
+		return engl_search(query, limit);
+	}
 
-			if (cmp_chars(row_i, col_j)) {
-				cost = 0;
-			}
-			else {
-				cost = 1;
+	const std::u32string folded_query = fold_word(query);
+
+	if ((int)char_count(query) <= cutoff) {
+		return basic_search(folded_query, limit);
+	}
+
+	return lev_search(folded_query, limit, cutoff, fuzzy_index, stats, thread_pool, stop);
+}
+
+std::vector<std::vector<std::string>> Dictionary::search_batch(
+	std::span<const std::string_view> queries,
+	size_t limit,
+	int cutoff,
+	bool engl,
+	FuzzyIndex fuzzy_index,
+	SearchStats* stats,
+	ThreadPool* thread_pool
+) const {
+	std::vector<std::vector<std::string>> out(queries.size());
+	// Queries that are the same (once they're folded, for Akkadian) have the same results, so only the first of
+	// them is searched. first[i] is the index of the first query that's the same as queries[i].
+	std::vector<size_t> first(queries.size());
+	std::vector<std::u32string> folded_queries;
+	std::vector<size_t> fuzzy_indices;
+
+	if (engl) {
+		std::unordered_map<std::string_view, size_t> seen;
+
+		for (size_t i = 0; i < queries.size(); i++) {
+			auto [it, added] = seen.emplace(queries[i], i);
+			first[i] = it->second;
+
+			if (added) {
+				out[i] = engl_search(queries[i], limit);
 			}
+		}
+	}
+	else {
+		std::unordered_map<std::u32string, size_t> seen;
 
-			int m_min = v0[row_idx] + 1;
-			int b = v1[row_idx - 1] + 1;
-			int c = v0[row_idx - 1] + cost;
+		for (size_t i = 0; i < queries.size(); i++) {
+			auto [it, added] = seen.emplace(fold_word(queries[i]), i);
+			first[i] = it->second;
 
-			if (b < m_min) {
-				m_min = b;
+			if (!added) {
+				continue;
 			}
 
-			if (c < m_min) {
-				m_min = c;
+			if ((int)char_count(queries[i]) <= cutoff) {
+				out[i] = basic_search(it->first, limit);
+			}
+			else {
+				folded_queries.push_back(it->first);
+				fuzzy_indices.push_back(i);
 			}
+		}
+	}
 
-			v1[row_idx] = m_min;
+	if (!fuzzy_indices.empty()) {
+		std::vector<std::vector<std::string>> results = lev_search_batch(
+			folded_queries,
+			limit,
+			cutoff,
+			fuzzy_index,
+			stats,
+			thread_pool
+		);
+
+		for (size_t i = 0; i < fuzzy_indices.size(); i++) {
+			out[fuzzy_indices[i]] = std::move(results[i]);
 		}
+	}
 
-		v_tmp = v0;
-		v0 = v1;
-		v1 = v_tmp;
+	for (size_t i = 0; i < queries.size(); i++) {
+		if (first[i] != i) {
+			out[i] = out[first[i]];
+		}
 	}
 
-	return v0[n];
+	return out;
 }
 
-static int hamming_dist(const std::wstring& s, const std::wstring& t) {
-	int out = 0;
+std::vector<std::string> Dictionary::engl_search(std::string_view query, size_t limit) const {
+	const std::vector<Symbol>& keys = engl_dict().keys;
+	std::vector<uint32_t> results;
 
-	for (size_t i = 0; i < s.size(); i++) {
-		if (!cmp_chars(s[i], t[i])) {
-			out += 1;
-		}
-	}
+	// A byte search is enough here: a UTF-8 sequence can't match in the middle of another one
+	engl_suffixes().find(query, limit, results);
+
+	std::vector<std::string> out;
+	std::transform(results.begin(), results.end(), std::back_inserter(out), [&](uint32_t pos) {
+		return std::string(Akk::symbols.str(keys[pos]));
+	});
 
 	return out;
 }
 
-std::vector<std::wstring> Dictionary::search(std::wstring& query, size_t limit, int cutoff, bool engl) const {
-	if (engl) {
-		return engl_search(query, limit);
-	}
+const SuffixArray& Dictionary::engl_suffixes() const {
+	const EnglDict& dict = engl_dict();
 
-	if (query.size() <= cutoff) {
-		return basic_search(query, limit);
-	}
+	std::call_once(engl->suffixes_built, [&] {
+		engl->suffixes.build(dict.keys);
+	});
 
-	return lev_search(query, limit, cutoff);
+	return engl->suffixes;
 }
 
-std::vector<std::wstring> Dictionary::engl_search(std::wstring& query, size_t limit) const {
-	std::vector<std::wstring> out;
-	
-	for (const std::wstring& word : engl_keys) {
-		if (word.find(query) != std::wstring::npos) {
-			out.push_back(word);
-		}
-	}
+const BKTree& Dictionary::akk_tree() const {
+	std::call_once(akk_search->tree_built, [this] {
+		akk_search->tree.build(akk_folded);
+	});
+
+	return akk_search->tree;
+}
 
-	std::sort(out.begin(), out.end(), [](const std::wstring& lhs, const std::wstring& rhs) {
-		return lhs.size() < rhs.size();
+const Dawg& Dictionary::akk_dawg() const {
+	std::call_once(akk_search->dawg_built, [this] {
+		akk_search->dawg.build(akk_folded);
 	});
 
-	if (out.size() > limit) {
-		out.resize(limit);
-	}
+	return akk_search->dawg;
+}
 
-	return out;
+const KeyColumns& Dictionary::akk_columns() const {
+	std::call_once(akk_search->columns_built, [this] {
+		akk_search->columns.build(akk_folded);
+	});
+
+	return akk_search->columns;
 }
 
-std::vector<std::wstring> Dictionary::lev_search(std::wstring& query, size_t limit, int cutoff) const {
-	typedef std::pair<int, std::wstring> DistWord;
+const PrefixIndex& Dictionary::akk_prefixes() const {
+	std::call_once(akk_search->prefixes_built, [this] {
+		akk_search->prefixes.build(akk_folded);
+	});
 
-	std::vector<DistWord> results;
+	return akk_search->prefixes;
+}
 
-	for (const std::wstring& word : akk_keys) {
-		int lev = lev_dist(query, word);
+std::vector<std::string> Dictionary::lev_search(
+	std::u32string_view folded_query,
+	size_t limit,
+	int cutoff,
+	FuzzyIndex fuzzy_index,
+	SearchStats* stats,
+	ThreadPool* thread_pool,
+	std::stop_token stop
+) const {
+	// Words are sharded by rank in the word graph, and keys by position otherwise
+	const size_t num_items = fuzzy_index == Automaton ? akk_dawg().num_words() : akk_folded.size();
+	size_t num_shards = 1;
+	std::vector<uint32_t> tree_matches;
+
+	if (thread_pool) {
+		num_shards = (std::max)((size_t)1, (num_items + FUZZY_SHARD_SIZE - 1) / FUZZY_SHARD_SIZE);
+
+		if (fuzzy_index == Automaton) {
+			num_shards = (std::min)(num_shards, (thread_pool->size() + 1) * GRAPH_SHARDS_PER_THREAD);
+		}
+	}
 
-		// Prioritize substitutions at the start of the word
-		if (query.size() <= word.size()) {
-			int ham = hamming_dist(query, word);
+	// The tree only finds words that are close enough by Levenshtein distance. A word that is at least as long
+	// as the query can also match by the Hamming distance of its first characters, which the tree can't search
+	// for, so every key is still checked for that.
+	if (fuzzy_index == MetricTree) {
+		size_t tree_cells = 0;
 
-			lev = min(lev, ham);
+		// If the search is cancelled, the tree stops early, but every shard checks for that before it uses the
+		// matches
+		if (thread_pool) {
+			akk_tree().find(folded_query, cutoff, tree_matches, tree_cells, *thread_pool, stop);
+		}
+		else {
+			akk_tree().find(folded_query, cutoff, tree_matches, tree_cells);
 		}
+		std::sort(tree_matches.begin(), tree_matches.end());
 
-		if (lev <= cutoff) {
-			results.push_back(std::pair<int, std::wstring>(lev, word));
+		if (stats) {
+			stats->dp_cells += tree_cells;
 		}
 	}
 
-	std::sort(results.begin(), results.end(), [](const DistWord& lhs, const DistWord& rhs) {
-		return lhs.first < rhs.first;
-	});
+	// Each shard keeps its own best 'limit' matches, ordered the same way as the whole search, so merging them
+	// gives exactly the same results as searching on one thread
+	std::vector<TopScores> shard_tops(num_shards, TopScores(limit));
+	std::vector<size_t> shard_cells(num_shards);
+
+	auto search_shard = [&](size_t i) {
+		const uint32_t begin = (uint32_t)(num_items * i / num_shards);
+		const uint32_t end = (uint32_t)(num_items * (i + 1) / num_shards);
 
-	if (results.size() > limit) {
-		results.resize(limit);
+		// Shards that start after the search is cancelled don't search anything
+		if (stop.stop_requested()) {
+			throw SearchCancelled{};
+		}
+
+		if (fuzzy_index == Automaton) {
+			akk_dawg().find(folded_query, cutoff, begin, end, shard_tops[i], shard_cells[i]);
+		}
+		else {
+			KeyScan scan = start_scan(folded_query, cutoff, tree_matches, begin, limit);
+
+			for (uint32_t pos = begin; pos < end; pos++) {
+				if ((pos - begin) % CANCEL_CHECK_INTERVAL == 0 && stop.stop_requested()) {
+					throw SearchCancelled{};
+				}
+
+				scan_key(scan, pos, akk_folded[pos]);
+			}
+
+			shard_tops[i] = std::move(scan.top);
+			shard_cells[i] = scan.cells;
+		}
+	};
+
+	if (thread_pool) {
+		thread_pool->for_each(num_shards, search_shard);
+	}
+	else {
+		search_shard(0);
 	}
 
-	std::vector<std::wstring> out;
-	std::transform(results.begin(), results.end(), std::back_inserter(out), [](const DistWord& item) {
-		return item.second;
-	});
+	TopScores top(limit);
 
-	return out;
+	for (size_t i = 0; i < num_shards; i++) {
+		for (const std::pair<int, uint32_t>& item : shard_tops[i].sorted()) {
+			top.add(item.first, item.second);
+		}
+
+		if (stats) {
+			stats->dp_cells += shard_cells[i];
+		}
+	}
+
+	return top_keys(top);
 }
 
-std::vector<std::wstring> Dictionary::basic_search(std::wstring& query, size_t limit) const {
-	std::vector<std::wstring> out;
+std::vector<std::vector<std::string>> Dictionary::lev_search_batch(
+	std::span<const std::u32string> folded_queries,
+	size_t limit,
+	int cutoff,
+	FuzzyIndex fuzzy_index,
+	SearchStats* stats,
+	ThreadPool* thread_pool
+) const {
+	std::vector<std::vector<std::string>> out(folded_queries.size());
+
+	// The word graph is walked once per query, so there's no scan to share
+	if (fuzzy_index == Automaton) {
+		for (size_t i = 0; i < folded_queries.size(); i++) {
+			out[i] = lev_search(folded_queries[i], limit, cutoff, fuzzy_index, stats, thread_pool, {});
+		}
+
+		return out;
+	}
+
+	const size_t num_blocks = (folded_queries.size() + BATCH_BLOCK_SIZE - 1) / BATCH_BLOCK_SIZE;
+	std::vector<size_t> block_cells(num_blocks);
+
+	// The queries are scanned in blocks, and each key is loaded once per block and checked against every query in
+	// it. The blocks are independent, so they're searched in parallel if there's a pool.
+	auto search_block = [&](size_t block) {
+		const size_t begin = block * BATCH_BLOCK_SIZE;
+		const size_t end = (std::min)(begin + BATCH_BLOCK_SIZE, folded_queries.size());
+		std::vector<std::vector<uint32_t>> tree_matches(end - begin);
+		std::vector<KeyScan> scans;
+
+		for (size_t i = begin; i < end; i++) {
+			std::vector<uint32_t>& matches = tree_matches[i - begin];
+
+			akk_tree().find(folded_queries[i], cutoff, matches, block_cells[block]);
+			std::sort(matches.begin(), matches.end());
+			scans.push_back(start_scan(folded_queries[i], cutoff, matches, 0, limit));
+		}
 
-	for (const std::wstring& word : akk_keys) {
-		if (akk_starts_with(word, query)) {
-			out.push_back(word);
+		for (uint32_t pos = 0; pos < akk_folded.size(); pos++) {
+			const std::u32string_view word = akk_folded[pos];
+
+			for (KeyScan& scan : scans) {
+				scan_key(scan, pos, word);
+			}
+		}
+
+		for (size_t i = begin; i < end; i++) {
+			out[i] = top_keys(scans[i - begin].top);
+			block_cells[block] += scans[i - begin].cells;
+		}
+	};
+
+	if (thread_pool) {
+		thread_pool->for_each(num_blocks, search_block);
+	}
+	else {
+		for (size_t block = 0; block < num_blocks; block++) {
+			search_block(block);
 		}
 	}
 
-	std::sort(out.begin(), out.end(), [](const std::wstring& lhs, const std::wstring& rhs) {
-		return lhs.size() < rhs.size();
+	if (stats) {
+		for (size_t cells : block_cells) {
+			stats->dp_cells += cells;
+		}
+	}
+
+	return out;
+}
+
+std::vector<std::string> Dictionary::top_keys(const TopScores& top) const {
+	const std::vector<std::pair<int, uint32_t>> results = top.sorted();
+
+	std::vector<std::string> out;
+	std::transform(results.begin(), results.end(), std::back_inserter(out), [this](const std::pair<int, uint32_t>& item) {
+		return std::string(Akk::symbols.str(akk_keys[item.second]));
 	});
 
-	if (out.size() > limit) {
-		out.resize(limit);
-	}
+	return out;
+}
+
+std::vector<std::string> Dictionary::basic_search(std::u32string_view folded_query, size_t limit) const {
+	std::vector<uint32_t> results;
+	akk_prefixes().find(akk_folded, folded_query, limit, results);
+
+	std::vector<std::string> out;
+	std::transform(results.begin(), results.end(), std::back_inserter(out), [this](uint32_t pos) {
+		return std::string(Akk::symbols.str(akk_keys[pos]));
+	});
 
 	return out;
-}
\ No newline at end of file
+}
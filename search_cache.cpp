@@ -0,0 +1,162 @@
+#include "search_cache.h"
+#include "errors.h"
+#include "letters.h"
+
+// Memory limit of the lookup dialogs' cache. A lookup with 15 results and their summaries is a few KB.
+const size_t SEARCH_CACHE_SIZE = 4 * 1024 * 1024;
+
+SearchCache Akk::search_cache(SEARCH_CACHE_SIZE);
+
+SearchCache::SearchCache(size_t max_bytes) : max_bytes(max_bytes) {}
+
+std::shared_ptr<const Lookup> SearchCache::lookup(
+	const std::shared_ptr<const Dictionary>& dict,
+	std::string_view query,
+	size_t limit,
+	int cutoff,
+	bool engl,
+	ThreadPool* thread_pool,
+	std::stop_token stop
+) {
+	std::string key = make_key(query, limit, cutoff, engl);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		set_version(dict);
+
+		auto it = index.find(key);
+
+		if (it != index.end()) {
+			entries.splice(entries.begin(), entries, it->second);
+			counters.hits++;
+
+			return it->second->lookup;
+		}
+
+		counters.misses++;
+	}
+
+	// The search runs without the lock so that other lookups aren't held up by it
+	std::shared_ptr<const Lookup> out = make_lookup(
+		*dict,
+		dict->search(query, limit, cutoff, engl, MetricTree, nullptr, thread_pool, stop),
+		engl,
+		stop
+	);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Another thread could have made the same lookup in the meantime, or made one in a newer version
+	if (index.contains(key) || dict_version.lock() != dict) {
+		return out;
+	}
+
+	Entry entry{};
+	entry.key = std::move(key);
+	entry.lookup = out;
+	entry.bytes = entry_bytes(entry);
+
+	entries.push_front(std::move(entry));
+	index.emplace(entries.front().key, entries.begin());
+	counters.bytes += entries.front().bytes;
+	evict();
+
+	return out;
+}
+
+std::shared_ptr<Lookup> make_lookup(
+	const Dictionary& dict,
+	std::vector<std::string> results,
+	bool engl,
+	std::stop_token stop
+) {
+	std::shared_ptr<Lookup> out = std::make_shared<Lookup>();
+	out->results = std::move(results);
+
+	for (const std::string& result : out->results) {
+		if (stop.stop_requested()) {
+			throw SearchCancelled{};
+		}
+
+		out->summary += engl ? dict.engl_summary(result) : dict.akk_summary(result);
+	}
+
+	return out;
+}
+
+SearchCacheStats SearchCache::stats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	SearchCacheStats out = counters;
+	out.entries = entries.size();
+
+	return out;
+}
+
+void SearchCache::clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	index.clear();
+	entries.clear();
+	counters.bytes = 0;
+}
+
+/**
+ * Makes the key for a lookup. The text of the query comes last, so keys with different queries can't be the same.
+ */
+std::string SearchCache::make_key(std::string_view query, size_t limit, int cutoff, bool engl) {
+	std::string out = std::to_string(limit) + " " + std::to_string(cutoff) + (engl ? " E " : " A ");
+
+	if (engl) {
+		out += query;
+	}
+	else {
+		const std::u32string folded = fold_word(query);
+		out.append((const char*)folded.data(), folded.size() * sizeof(char32_t));
+	}
+
+	return out;
+}
+
+size_t SearchCache::entry_bytes(const Entry& entry) {
+	size_t out = sizeof(Entry) + sizeof(Lookup) + entry.key.capacity() + entry.lookup->summary.capacity();
+
+	// The list node and hash table entry
+	out += 4 * sizeof(void*) + sizeof(std::pair<std::string_view, std::list<Entry>::iterator>);
+
+	for (const std::string& result : entry.lookup->results) {
+		out += sizeof(std::string) + result.capacity();
+	}
+
+	return out;
+}
+
+/**
+ * Clears the cache if a lookup is being made in a different version of the dictionary from the cached ones.
+ * The mutex must be held.
+ */
+void SearchCache::set_version(const std::shared_ptr<const Dictionary>& dict) {
+	if (dict_version.lock() == dict) {
+		return;
+	}
+
+	if (!entries.empty()) {
+		counters.invalidations++;
+	}
+
+	index.clear();
+	entries.clear();
+	counters.bytes = 0;
+	dict_version = dict;
+}
+
+/**
+ * Drops the least recently used lookups until the cache fits in its memory limit. The mutex must be held.
+ */
+void SearchCache::evict() {
+	while (counters.bytes > max_bytes && !entries.empty()) {
+		counters.bytes -= entries.back().bytes;
+		counters.evictions++;
+		index.erase(entries.back().key);
+		entries.pop_back();
+	}
+}
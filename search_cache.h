@@ -0,0 +1,112 @@
+/**
+ * Cache of recent lookups, so that a repeated query doesn't run the search and build the summaries again.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "dict.h"
+
+/**
+ * The results of a lookup and the summaries of all of them, one after the other
+ */
+typedef struct Lookup {
+	std::vector<std::string> results{};
+	std::string summary{};
+} Lookup;
+
+/**
+ * Builds a lookup from the results of a search, with the summary of each result. If a stop is requested on 'stop'
+ * partway, it throws SearchCancelled (see errors.h).
+ */
+std::shared_ptr<Lookup> make_lookup(
+	const Dictionary& dict,
+	std::vector<std::string> results,
+	bool engl,
+	std::stop_token stop = {}
+);
+
+typedef struct SearchCacheStats {
+	size_t hits{};
+	size_t misses{};
+	// Lookups that were dropped to make room for newer ones
+	size_t evictions{};
+	// Times the cache was cleared because the dictionary was reloaded
+	size_t invalidations{};
+	size_t entries{};
+	// Approximate memory used by the cached lookups
+	size_t bytes{};
+} SearchCacheStats;
+
+/**
+ * A least recently used cache of lookups, keyed by the query, the language, and the limit and cutoff of the
+ * search. Akkadian queries are folded first (see letters.h), because the search can't tell apart queries that
+ * fold to the same thing. When the cache would use more than its memory limit, the least recently used lookups
+ * are dropped.
+ *
+ * The cached lookups belong to one version of the dictionary. When a lookup is made in a different version (after
+ * a reload), the cache is cleared first. The cache can be used from any number of threads at once.
+ */
+typedef struct SearchCache {
+	SearchCache(size_t max_bytes);
+
+	SearchCache(const SearchCache&) = delete;
+	SearchCache& operator=(const SearchCache&) = delete;
+
+	/**
+	 * Returns the lookup for a query, searching the dictionary and building the summaries if it isn't cached.
+	 * The arguments are the same as for Dictionary::search. If a stop is requested on 'stop' before the lookup
+	 * is done, it throws SearchCancelled (see errors.h) and nothing is cached.
+	 */
+	std::shared_ptr<const Lookup> lookup(
+		const std::shared_ptr<const Dictionary>& dict,
+		std::string_view query,
+		size_t limit,
+		int cutoff,
+		bool engl,
+		ThreadPool* thread_pool = nullptr,
+		std::stop_token stop = {}
+	);
+
+	SearchCacheStats stats() const;
+
+	void clear();
+
+private:
+	typedef struct Entry {
+		std::string key{};
+		std::shared_ptr<const Lookup> lookup{};
+		size_t bytes{};
+	} Entry;
+
+	size_t max_bytes{};
+	mutable std::mutex mutex{};
+	// The version of the dictionary that the cached lookups came from. This doesn't keep the dictionary alive,
+	// and if it's been destroyed, it doesn't match any other version even if it had the same address.
+	std::weak_ptr<const Dictionary> dict_version{};
+	// Most recently used first
+	std::list<Entry> entries{};
+	std::unordered_map<std::string_view, std::list<Entry>::iterator> index{};
+	SearchCacheStats counters{};
+
+	static std::string make_key(std::string_view query, size_t limit, int cutoff, bool engl);
+	static size_t entry_bytes(const Entry& entry);
+
+	void set_version(const std::shared_ptr<const Dictionary>& dict);
+	void evict();
+} SearchCache;
+
+namespace Akk {
+	/**
+	 * The cache used by the lookup dialogs
+	 */
+	extern SearchCache search_cache;
+}
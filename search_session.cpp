@@ -0,0 +1,272 @@
+#include "search_session.h"
+#include <algorithm>
+#include "errors.h"
+#include "letters.h"
+
+SearchSession::SearchSession(std::shared_ptr<const Dictionary> dict, size_t limit, int cutoff, bool engl) :
+	dict(dict),
+	limit(limit),
+	cutoff(cutoff),
+	engl(engl)
+{}
+
+const std::vector<std::string>& SearchSession::set_query(std::string_view new_query, SearchStats* stats, std::stop_token stop) {
+	if (!started) {
+		start();
+		started = true;
+	}
+
+	if (engl || levels.empty()) {
+		if (!searched || new_query != query) {
+			// If the search is cancelled, the results don't match the query until the next one finishes
+			searched = false;
+			query = new_query;
+			results = dict->search(query, limit, cutoff, engl, MetricTree, stats, nullptr, stop);
+			searched = true;
+		}
+
+		return results;
+	}
+
+	const std::u32string folded = fold_word(new_query);
+	query = new_query;
+
+	// Queries that fold to the same thing have the same results
+	if (searched && folded == folded_query) {
+		return results;
+	}
+
+	searched = false;
+
+	auto diff = std::mismatch(folded.begin(), folded.end(), folded_query.begin(), folded_query.end());
+	const size_t same = diff.first - folded.begin();
+	size_t cells = 0;
+
+	num_levels = same + 1;
+	folded_query.resize(same);
+
+	// A cancelled search stops between chars. The rows for the chars that were added are kept, and the next
+	// search goes on from them.
+	for (size_t i = same; i < folded.size(); i++) {
+		if (stop.stop_requested()) {
+			throw SearchCancelled{};
+		}
+
+		push(folded[i], cells);
+	}
+
+	if (stop.stop_requested()) {
+		throw SearchCancelled{};
+	}
+
+	if ((int)folded_query.size() <= cutoff) {
+		results = dict->basic_search(folded_query, limit);
+	}
+	else {
+		TopScores top(limit);
+		score(top);
+		results = dict->top_keys(top);
+	}
+
+	searched = true;
+
+	if (stats) {
+		stats->dp_cells += cells;
+	}
+
+	return results;
+}
+
+const std::shared_ptr<const Dictionary>& SearchSession::get_dict() const {
+	return dict;
+}
+
+bool SearchSession::get_engl() const {
+	return engl;
+}
+
+/**
+ * Computes the row for an empty query. This waits for the first search, so that starting a session doesn't do any
+ * work on the thread that starts it.
+ */
+void SearchSession::start() {
+	if (engl || !dict->akk_columns().usable()) {
+		return;
+	}
+
+	// With no query, the distance to the first j chars of a key is j
+	const KeyColumns& columns = dict->akk_columns();
+	const size_t stride = columns.padded_size();
+	const uint8_t over = (uint8_t)(cutoff + 1);
+	Level first{};
+
+	over_row.resize(stride, over);
+	first.cells.resize(band_size() * stride);
+	first.mismatches.resize(stride);
+	first.live.resize(num_blocks(), 1);
+
+	for (size_t k = 0; k < band_size(); k++) {
+		const int j = (int)k - cutoff;
+
+		for (size_t key = 0; key < stride; key++) {
+			first.cells[k * stride + key] = j < 0 || j > columns.lengths()[key] ? over : (uint8_t)j;
+		}
+	}
+
+	levels.push_back(std::move(first));
+	num_levels = 1;
+}
+
+size_t SearchSession::band_size() const {
+	return 2 * (size_t)cutoff + 1;
+}
+
+size_t SearchSession::num_blocks() const {
+	return over_row.size() / BLOCK_SIZE;
+}
+
+/**
+ * Adds a char to the query and computes the next row for every block of keys that's still in the running. Each
+ * block's row is built up on the stack a cell at a time, and every loop over the keys in a block has the same
+ * number of steps, so the compiler can turn them into vector instructions.
+ */
+void SearchSession::push(char32_t c, size_t& cells) {
+	const KeyColumns& columns = dict->akk_columns();
+	const size_t stride = columns.padded_size();
+	const size_t band = band_size();
+	const uint8_t over = (uint8_t)(cutoff + 1);
+	const uint8_t code = columns.code(c);
+	// The row being computed
+	const int i = (int)folded_query.size() + 1;
+
+	if (levels.size() == num_levels) {
+		levels.emplace_back();
+	}
+
+	const Level& prev = levels[num_levels - 1];
+	Level& next = levels[num_levels];
+
+	next.cells.resize(band * stride);
+	next.mismatches.resize(stride);
+	next.live.assign(num_blocks(), 0);
+
+	// Cell k is in column j = i + k - cutoff. The cell above it in the previous row is k + 1, and the one to the
+	// upper left is k.
+	std::vector<const uint8_t*> key_columns(band);
+
+	for (size_t k = 0; k < band; k++) {
+		const int j = i + (int)k - cutoff;
+
+		key_columns[k] = j > 0 ? columns.column(j - 1).data() : nullptr;
+	}
+
+	const uint8_t* start_column = columns.column(i - 1).data();
+
+	for (size_t block = 0; block < num_blocks(); block++) {
+		if (!prev.live[block]) {
+			continue;
+		}
+
+		const size_t begin = block * BLOCK_SIZE;
+		// Cell k - 1 of the row being computed, and then cell k
+		uint8_t left[BLOCK_SIZE];
+		uint8_t cell[BLOCK_SIZE];
+		uint8_t row_min[BLOCK_SIZE];
+
+		std::fill(std::begin(left), std::end(left), over);
+		std::fill(std::begin(row_min), std::end(row_min), over);
+
+		for (size_t k = 0; k < band; k++) {
+			const int j = i + (int)k - cutoff;
+			const uint8_t* chars = key_columns[k];
+
+			if (!chars) {
+				std::fill(std::begin(cell), std::end(cell), j == 0 ? (uint8_t)(std::min)(i, (int)over) : over);
+			}
+			else {
+				// Copied so that the loop only touches the stack and doesn't have to check if the rows overlap
+				uint8_t diag[BLOCK_SIZE];
+				uint8_t up[BLOCK_SIZE];
+				uint8_t chars_copy[BLOCK_SIZE];
+				const uint8_t* up_row = k + 1 < band ? prev.cells.data() + (k + 1) * stride : over_row.data();
+
+				std::copy_n(prev.cells.data() + k * stride + begin, BLOCK_SIZE, diag);
+				std::copy_n(up_row + begin, BLOCK_SIZE, up);
+				std::copy_n(chars + begin, BLOCK_SIZE, chars_copy);
+
+				for (size_t key = 0; key < BLOCK_SIZE; key++) {
+					uint8_t value = (uint8_t)(diag[key] + (chars_copy[key] == code ? 0 : 1));
+
+					value = (std::min)(value, (uint8_t)(up[key] + 1));
+					value = (std::min)(value, (uint8_t)(left[key] + 1));
+					value = (std::min)(value, over);
+					// Past the end of the key
+					cell[key] = chars_copy[key] == KeyColumns::END ? over : value;
+				}
+
+				cells += BLOCK_SIZE;
+			}
+
+			for (size_t key = 0; key < BLOCK_SIZE; key++) {
+				row_min[key] = (std::min)(row_min[key], cell[key]);
+			}
+
+			std::copy(std::begin(cell), std::end(cell), next.cells.data() + k * stride + begin);
+			std::copy(std::begin(cell), std::end(cell), std::begin(left));
+		}
+
+		uint8_t start_chars[BLOCK_SIZE];
+		uint8_t mismatches[BLOCK_SIZE];
+		uint8_t live = 0;
+
+		std::copy_n(start_column + begin, BLOCK_SIZE, start_chars);
+		std::copy_n(prev.mismatches.data() + begin, BLOCK_SIZE, mismatches);
+
+		for (size_t key = 0; key < BLOCK_SIZE; key++) {
+			const uint8_t value = (uint8_t)(mismatches[key] + (start_chars[key] == code ? 0 : 1));
+
+			mismatches[key] = start_chars[key] == KeyColumns::END ? over : (std::min)(value, over);
+			live |= (uint8_t)((row_min[key] <= cutoff) | (mismatches[key] <= cutoff));
+		}
+
+		std::copy(std::begin(mismatches), std::end(mismatches), next.mismatches.data() + begin);
+		next.live[block] = live;
+	}
+
+	folded_query.push_back(c);
+	num_levels++;
+}
+
+/**
+ * Scores the keys that are left the same way as the fuzzy search in search.cpp
+ */
+void SearchSession::score(TopScores& top) const {
+	const KeyColumns& columns = dict->akk_columns();
+	const size_t num_keys = columns.size();
+	const size_t stride = columns.padded_size();
+	const Level& level = levels[num_levels - 1];
+	const int i = (int)folded_query.size();
+
+	for (size_t block = 0; block < num_blocks(); block++) {
+		if (!level.live[block]) {
+			continue;
+		}
+
+		// The padding at the end isn't a key
+		const size_t end = (std::min)((block + 1) * BLOCK_SIZE, num_keys);
+
+		for (size_t key = block * BLOCK_SIZE; key < end; key++) {
+			// The distance to the whole key is in the band if the lengths are close enough
+			const int k = columns.lengths()[key] - i + cutoff;
+			int dist = k >= 0 && k < (int)band_size() ? level.cells[k * stride + key] : cutoff + 1;
+
+			// Prioritize substitutions at the start of the word. This is over the cutoff if the key is shorter
+			// than the query.
+			dist = (std::min)(dist, (int)level.mismatches[key]);
+
+			if (dist <= cutoff) {
+				top.add(dist, columns.positions()[key]);
+			}
+		}
+	}
+}
@@ -0,0 +1,96 @@
+/**
+ * Search-as-you-type for the lookup dialogs.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "dict.h"
+
+/**
+ * A search whose query changes one keystroke at a time. The results are always the same as from
+ * Dictionary::search, but the fuzzy Akkadian search doesn't start over for every keystroke.
+ *
+ * For each key, the session keeps the row of the edit distance table for every length of the query typed so far:
+ * the distances from the query to each start of the key. Typing a char adds a row, which is computed from the
+ * previous one, and deleting a char goes back to the previous row. Only the cells within 'cutoff' of the diagonal
+ * are kept. A key is out of the running once every cell of its row is over the cutoff and so is the Hamming
+ * distance between the query and the start of the key, because neither of them can go down as the query gets
+ * longer.
+ *
+ * The rows are stored a cell at a time for all the keys (see key_columns.h), so that a row is computed for many
+ * keys at once with vector instructions, and the keys are split into blocks that are skipped once every key in
+ * them is out of the running.
+ *
+ * The session is tied to one version of the dictionary, so a new session has to be started after a reload. It can
+ * be used from any thread, but only from one at a time. Nothing is computed until the first query, so a session
+ * can be started on the UI thread and searched on a worker (see AsyncSearch in async_search.h).
+ */
+typedef struct SearchSession {
+	/**
+	 * Starts a session with an empty query. The arguments are the same as for Dictionary::search. The distances
+	 * are stored in bytes, so 'cutoff' must be less than 254.
+	 */
+	SearchSession(std::shared_ptr<const Dictionary> dict, size_t limit, int cutoff, bool engl);
+
+	/**
+	 * Changes the query and returns the results. The part at the start of the query that is the same as before
+	 * (once it's folded, for Akkadian) isn't searched again. If 'stats' isn't null, the search's counters are
+	 * added to it. If a stop is requested on 'stop', the search throws SearchCancelled (see errors.h) between
+	 * chars of the query, and the session can still be searched again.
+	 */
+	const std::vector<std::string>& set_query(
+		std::string_view query,
+		SearchStats* stats = nullptr,
+		std::stop_token stop = {}
+	);
+
+	const std::shared_ptr<const Dictionary>& get_dict() const;
+	bool get_engl() const;
+
+private:
+	static const size_t BLOCK_SIZE = KeyColumns::BLOCK_SIZE;
+
+	typedef struct Level {
+		// Cell k of each key's row is cells[k * padded_size + key], with keys in the order of KeyColumns. For the
+		// first 'i' chars of the query, cell k is the distance to the first i + k - cutoff chars of the key, at
+		// most cutoff + 1.
+		std::vector<uint8_t> cells{};
+		// The Hamming distance between the query and the start of each key, or cutoff + 1 if it's over the
+		// cutoff or the key is shorter than the query
+		std::vector<uint8_t> mismatches{};
+		// Nonzero for each block of keys that has a key still in the running
+		std::vector<uint8_t> live{};
+	} Level;
+
+	std::shared_ptr<const Dictionary> dict{};
+	size_t limit{};
+	int cutoff{};
+	bool engl{};
+	std::string query{};
+	std::vector<std::string> results{};
+	// True once the results are for the query. A cancelled search leaves this false.
+	bool searched{};
+	// False until the row for the empty query is computed
+	bool started{};
+
+	std::u32string folded_query{};
+	// levels[i] is for the first i chars of the folded query. Levels past num_levels are kept to reuse their
+	// memory.
+	std::vector<Level> levels{};
+	size_t num_levels{};
+	// A cutoff + 1 for every key and the padding, for the cells outside the band
+	std::vector<uint8_t> over_row{};
+
+	size_t band_size() const;
+	size_t num_blocks() const;
+	void start();
+	void push(char32_t c, size_t& cells);
+	void score(TopScores& top) const;
+} SearchSession;
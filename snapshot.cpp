@@ -0,0 +1,628 @@
+/**
+ * Compiled dictionary snapshots. Parsing the dictionary file means splitting text, merging entries, and
+ * resolving relations, which gets slow for a large dictionary. A snapshot is the result of all of that work
+ * written to a binary file, so that it can be loaded without any parsing on later runs.
+ *
+ * A snapshot is a cache, not an image of the dictionary in memory. Entries refer to strings by symbol, and
+ * symbols belong to the global symbol table (see symbols.h), which outlives any one file, so the mapping can't be
+ * used in place. Instead, every distinct string is stored once, and loading a snapshot interns each of them
+ * once. Everything else refers to strings by their index in the snapshot, so it's read without looking at any
+ * text: the entries are copied into pools that are allocated once at their full size, and the key index and the
+ * folded keys are restored as they were saved instead of being built again. Splitting lines, merging entries,
+ * resolving relations, hashing keys, and folding keys are all skipped.
+ *
+ * A snapshot file consists of a fixed-size header followed by a payload:
+ *
+ *		Header
+ *			magic				4 bytes, "AKKD"
+ *			version				u32, SNAPSHOT_VERSION
+ *			char_size			u32, size of a character in the snapshot's strings, always 1
+ *			reserved			u32
+ *			source_size			u64, size of the source file in bytes
+ *			source_mtime		u64, last write time of the source file
+ *			payload_size		u64
+ *			checksum			u64, FNV-1a hash of the payload
+ *
+ *		Payload
+ *			Strings
+ *			Akk->Engl dictionary
+ *			Key index
+ *			Folded keys
+ *			Source lines
+ *			Unresolved relations
+ *
+ * The strings are a u32 count followed by each distinct string as a u32 length in bytes and the UTF-8 text. In the
+ * rest of the payload, a string is a u32 index into this table.
+ *
+ * The dictionary starts with the number of entries, definitions, and relations in its pool, each a u32. Then there
+ * is a u32 key count followed by the keys in ascending order. Each key is a string followed by a u32 entry count
+ * and the entries. An entry is:
+ *
+ *			grammar_kind		u8
+ *			word_types			u8 count, followed by one u8 per word class
+ *			defns				u32 count, followed by the strings
+ *			relations			u32 count, followed by a u8 relation kind and a string for each relation
+ *
+ * The key index is the table of the KeyIndex for the keys: an array with the key position of every slot, and an
+ * array with the hash of every slot. The folded keys are an array with the chars of every folded key, back to back,
+ * and an array with the offset of every key in it (see FoldedKeys). An array is a u32 count followed by that many
+ * u32 values.
+ *
+ * The Engl->Akk dictionary is not stored, because it's only built when it's first needed (see EnglDict). The lines
+ * it's built from are stored instead, as the pool sizes, a u32 line count, and a string for the Akkadian word and
+ * an entry for each line. The definitions of a line's entry are its English words.
+ *
+ * The unresolved relations are a u32 count followed by a u32 line, a string for the word, a u8 relation kind,
+ * and a string for the target for each relation.
+ *
+ * All integers are little-endian and nothing is aligned.
+ *
+ * The snapshot is stale if the source file's size or modification time don't match the header. A stale,
+ * corrupt, or incompatible snapshot is ignored, and the dictionary is parsed from the source file again.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#include "common.h"
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dict.h"
+#include "errors.h"
+
+// Increment this whenever the layout of the payload changes
+const uint32_t SNAPSHOT_VERSION = 5;
+const char SNAPSHOT_MAGIC[4] = { 'A', 'K', 'K', 'D' };
+
+typedef struct SnapshotHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t char_size;
+	uint32_t reserved;
+	uint64_t source_size;
+	uint64_t source_mtime;
+	uint64_t payload_size;
+	uint64_t checksum;
+} SnapshotHeader;
+
+/**
+ * Thrown by SnapshotReader when the payload is truncated or contains an invalid value. This never
+ * escapes load_snapshot.
+ */
+typedef struct CorruptSnapshot {} CorruptSnapshot;
+
+static uint64_t fnv1a(const unsigned char* data, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+bool file_stamp(std::wstring& filename, FileStamp& stamp) {
+	WIN32_FILE_ATTRIBUTE_DATA attrs;
+
+	if (!GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &attrs)) {
+		return false;
+	}
+
+	stamp.size = ((uint64_t)attrs.nFileSizeHigh << 32) | attrs.nFileSizeLow;
+	stamp.mtime = ((uint64_t)attrs.ftLastWriteTime.dwHighDateTime << 32) | attrs.ftLastWriteTime.dwLowDateTime;
+
+	return true;
+}
+
+/**
+ * A read-only view of a whole file. The view is unmapped when this goes out of scope.
+ */
+typedef struct MappedFile {
+	HANDLE file{ INVALID_HANDLE_VALUE };
+	HANDLE mapping{};
+	const unsigned char* data{};
+	size_t size{};
+
+	MappedFile(std::wstring& filename) {
+		file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE) {
+			return;
+		}
+
+		LARGE_INTEGER file_size;
+
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+			return;
+		}
+
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (!mapping) {
+			return;
+		}
+
+		data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+		if (data) {
+			size = (size_t)file_size.QuadPart;
+		}
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() {
+		if (data) {
+			UnmapViewOfFile(data);
+		}
+
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+	}
+} MappedFile;
+
+typedef struct SnapshotWriter {
+	std::vector<unsigned char> buf{};
+	// The strings that have been written, in the order they were first written, and their indexes
+	std::vector<Symbol> strings{};
+	std::unordered_map<Symbol, uint32_t> string_indexes{};
+
+	void write_bytes(const void* data, size_t size) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		buf.insert(buf.end(), bytes, bytes + size);
+	}
+
+	void write_u8(uint8_t val) {
+		buf.push_back(val);
+	}
+
+	void write_u32(uint32_t val) {
+		write_bytes(&val, sizeof val);
+	}
+
+	void write_str(Symbol sym) {
+		auto [it, added] = string_indexes.emplace(sym, (uint32_t)strings.size());
+
+		if (added) {
+			strings.push_back(sym);
+		}
+
+		write_u32(it->second);
+	}
+
+	template <typename T>
+	void write_array(const T& values) {
+		static_assert(sizeof values[0] == sizeof(uint32_t), "Arrays are stored as u32s");
+
+		write_u32((uint32_t)values.size());
+		write_bytes(values.data(), values.size() * sizeof(uint32_t));
+	}
+
+	void write_pool_sizes(const EntryPool& pool) {
+		write_u32((uint32_t)pool.entries.size());
+		write_u32((uint32_t)pool.defns.size());
+		write_u32((uint32_t)pool.relations.size());
+	}
+
+	/**
+	 * Returns the payload: the table of every string that was written, followed by everything else
+	 */
+	std::vector<unsigned char> payload() const {
+		SnapshotWriter out;
+		out.write_u32((uint32_t)strings.size());
+
+		for (Symbol sym : strings) {
+			std::string_view str = Akk::symbols.str(sym);
+
+			out.write_u32((uint32_t)str.size());
+			out.write_bytes(str.data(), str.size());
+		}
+
+		out.buf.insert(out.buf.end(), buf.begin(), buf.end());
+
+		return out.buf;
+	}
+
+	void write_entry(const DictEntry& entry) {
+		std::vector<WordClass> word_types = entry.word_types();
+
+		write_u8((uint8_t)entry.grammar_kind);
+		write_u8((uint8_t)word_types.size());
+
+		for (WordClass c : word_types) {
+			write_u8((uint8_t)c);
+		}
+
+		write_u32((uint32_t)entry.num_defns);
+
+		for (Symbol defn : entry.defns()) {
+			write_str(defn);
+		}
+
+		write_u32((uint32_t)entry.num_relations);
+
+		for (const WordRelation& rel : entry.relations()) {
+			write_u8((uint8_t)rel.kind);
+			write_str(rel.word);
+		}
+	}
+
+	void write_key(Symbol key, std::span<const DictEntry> entries) {
+		write_str(key);
+		write_u32((uint32_t)entries.size());
+
+		for (const DictEntry& entry : entries) {
+			write_entry(entry);
+		}
+	}
+} SnapshotWriter;
+
+typedef struct SnapshotReader {
+	const unsigned char* pos;
+	const unsigned char* end;
+	// The string table, interned
+	std::vector<Symbol> strings{};
+
+	SnapshotReader(const unsigned char* data, size_t size) : pos(data), end(data + size) {}
+
+	const unsigned char* read_bytes(size_t size) {
+		if ((size_t)(end - pos) < size) {
+			throw CorruptSnapshot();
+		}
+
+		const unsigned char* out = pos;
+		pos += size;
+
+		return out;
+	}
+
+	uint8_t read_u8() {
+		return *read_bytes(1);
+	}
+
+	uint32_t read_u32() {
+		uint32_t val;
+		memcpy(&val, read_bytes(sizeof val), sizeof val);
+
+		return val;
+	}
+
+	uint8_t read_enum(size_t count) {
+		uint8_t val = read_u8();
+
+		if (val >= count) {
+			throw CorruptSnapshot();
+		}
+
+		return val;
+	}
+
+	/**
+	 * Reads the number of definitions or relations in an entry
+	 */
+	uint16_t read_count() {
+		uint32_t count = read_u32();
+
+		if (count > UINT16_MAX) {
+			throw CorruptSnapshot();
+		}
+
+		return (uint16_t)count;
+	}
+
+	/**
+	 * Reads a count of items that each take at least one byte. A count that's more than the bytes left is corrupt,
+	 * so it's never used to allocate more than the size of the snapshot.
+	 */
+	uint32_t read_size() {
+		uint32_t size = read_u32();
+
+		if (size > (size_t)(end - pos)) {
+			throw CorruptSnapshot();
+		}
+
+		return size;
+	}
+
+	/**
+	 * Reads the string table and interns every string in it. This is the only place that looks at the text.
+	 */
+	void read_strings() {
+		uint32_t num_strings = read_size();
+		strings.reserve(num_strings);
+
+		for (uint32_t i = 0; i < num_strings; i++) {
+			uint32_t len = read_u32();
+			const unsigned char* data = read_bytes(len);
+
+			strings.push_back(Akk::symbols.intern(std::string_view((const char*)data, len)));
+		}
+	}
+
+	Symbol read_str() {
+		uint32_t index = read_u32();
+
+		if (index >= strings.size()) {
+			throw CorruptSnapshot();
+		}
+
+		return strings[index];
+	}
+
+	/**
+	 * Reads an array of u32s into 'out', which can be any container of 4-byte values
+	 */
+	template <typename T>
+	void read_array(T& out) {
+		static_assert(sizeof out[0] == sizeof(uint32_t), "Arrays are stored as u32s");
+
+		uint32_t size = read_u32();
+		const unsigned char* data = read_bytes((size_t)size * sizeof(uint32_t));
+
+		out.resize(size);
+		memcpy(out.data(), data, (size_t)size * sizeof(uint32_t));
+	}
+
+	/**
+	 * Reads the sizes of a pool and allocates it at its full size
+	 */
+	void read_pool_sizes(EntryPool& pool) {
+		pool.entries.reserve(read_size());
+		pool.defns.reserve(read_size());
+		pool.relations.reserve(read_size());
+	}
+
+	/**
+	 * Reads an entry. Its definitions and relations are added to the end of the pool.
+	 */
+	DictEntry read_entry(EntryPool& pool) {
+		DictEntry entry;
+		entry.pool = &pool;
+		entry.grammar_kind = (GrammarKind)read_enum(NUM_GRAMMAR_KINDS);
+
+		uint8_t num_classes = read_u8();
+
+		for (uint8_t i = 0; i < num_classes; i++) {
+			entry.word_classes |= word_class_bit((WordClass)read_enum(NUM_WORD_CLASSES));
+		}
+
+		entry.defns_begin = (uint32_t)pool.defns.size();
+		entry.num_defns = read_count();
+
+		for (uint16_t i = 0; i < entry.num_defns; i++) {
+			pool.defns.push_back(read_str());
+		}
+
+		entry.relations_begin = (uint32_t)pool.relations.size();
+		entry.num_relations = read_count();
+
+		for (uint16_t i = 0; i < entry.num_relations; i++) {
+			WordRelationKind kind = (WordRelationKind)read_enum(NUM_FULL_RELATIONS);
+			pool.relations.push_back(WordRelation(kind, read_str()));
+		}
+
+		return entry;
+	}
+
+	/**
+	 * Reads a dictionary and its keys into the pool. The keys in the snapshot are already sorted.
+	 */
+	void read_dict(EntryPool& pool, std::vector<Symbol>& keys, std::vector<uint32_t>& offsets) {
+		read_pool_sizes(pool);
+
+		uint32_t num_keys = read_size();
+		keys.reserve(num_keys);
+		offsets.reserve((size_t)num_keys + 1);
+
+		for (uint32_t i = 0; i < num_keys; i++) {
+			Symbol key = read_str();
+
+			if (keys.size() && !Akk::symbols.less(keys.back(), key)) {
+				throw CorruptSnapshot();
+			}
+
+			uint32_t num_entries = read_u32();
+			offsets.push_back((uint32_t)pool.entries.size());
+
+			for (uint32_t j = 0; j < num_entries; j++) {
+				pool.entries.push_back(read_entry(pool));
+			}
+
+			keys.push_back(key);
+		}
+
+		offsets.push_back((uint32_t)pool.entries.size());
+	}
+} SnapshotReader;
+
+Dictionary Dictionary::load(std::wstring filename, std::wstring snapshot_filename, FileStamp* source_stamp) {
+	// The stamp is taken before the file is read, so that a change while it's being read isn't missed. If the
+	// snapshot is loaded instead, it was checked against a stamp taken after this one.
+	FileStamp stamp;
+	const bool stamped = file_stamp(filename, stamp);
+
+	if (source_stamp) {
+		*source_stamp = stamped ? stamp : FileStamp{};
+	}
+
+	std::optional<Dictionary> snapshot = load_snapshot(snapshot_filename, filename);
+
+	if (snapshot.has_value()) {
+		OutputDebugStringA("Loaded dictionary from snapshot\n");
+
+		return std::move(*snapshot);
+	}
+
+	Dictionary dict(filename);
+
+	if (!stamped || !dict.save_snapshot(snapshot_filename, stamp)) {
+		OutputDebugStringW((L"Failed to write dictionary snapshot: " + snapshot_filename + L"\n").c_str());
+	}
+
+	return dict;
+}
+
+std::optional<Dictionary> Dictionary::load_snapshot(std::wstring& snapshot_filename, std::wstring& source_filename) {
+	FileStamp source_stamp;
+
+	if (!file_stamp(source_filename, source_stamp)) {
+		return std::nullopt;
+	}
+
+	MappedFile file(snapshot_filename);
+
+	if (!file.data || file.size < sizeof(SnapshotHeader)) {
+		return std::nullopt;
+	}
+
+	SnapshotHeader header;
+	memcpy(&header, file.data, sizeof header);
+
+	const unsigned char* payload = file.data + sizeof header;
+	const size_t payload_size = file.size - sizeof header;
+
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC) ||
+		header.version != SNAPSHOT_VERSION ||
+		header.char_size != sizeof(char) ||
+		header.source_size != source_stamp.size ||
+		header.source_mtime != source_stamp.mtime ||
+		header.payload_size != payload_size ||
+		header.checksum != fnv1a(payload, payload_size)) {
+		return std::nullopt;
+	}
+
+	Dictionary out;
+	SnapshotReader reader(payload, payload_size);
+
+	try {
+		reader.read_strings();
+
+		out.pool = std::make_unique<EntryPool>();
+		reader.read_dict(*out.pool, out.akk_keys, out.akk_offsets);
+
+		std::vector<uint32_t> slot_positions;
+		std::vector<uint32_t> slot_hashes;
+		std::u32string folded_text;
+		std::vector<uint32_t> folded_offsets;
+
+		reader.read_array(slot_positions);
+		reader.read_array(slot_hashes);
+		reader.read_array(folded_text);
+		reader.read_array(folded_offsets);
+
+		// An index that can't be restored, like one from a program with a different hash function, is built again
+		if (!out.akk_index.restore(out.akk_keys, slot_positions, slot_hashes)) {
+			out.akk_index.build(out.akk_keys);
+		}
+
+		if (!out.akk_folded.restore(out.akk_keys.size(), std::move(folded_text), std::move(folded_offsets))) {
+			throw CorruptSnapshot();
+		}
+
+		reader.read_pool_sizes(out.engl->lines);
+
+		uint32_t num_lines = reader.read_size();
+		out.engl->lines.entries.reserve(num_lines);
+		out.engl->line_words.reserve(num_lines);
+
+		for (uint32_t i = 0; i < num_lines; i++) {
+			out.engl->line_words.push_back(reader.read_str());
+			out.engl->lines.entries.push_back(reader.read_entry(out.engl->lines));
+		}
+
+		uint32_t num_unresolved = reader.read_u32();
+
+		for (uint32_t i = 0; i < num_unresolved; i++) {
+			UnresolvedRelation rel;
+			rel.line = (int)reader.read_u32();
+			rel.word = reader.read_str();
+			rel.kind = (WordRelationKind)reader.read_enum(NUM_RELATIONS);
+			rel.target = reader.read_str();
+
+			out.unresolved.push_back(rel);
+		}
+	} catch (CorruptSnapshot) {
+		return std::nullopt;
+	}
+
+	if (reader.pos != reader.end) {
+		return std::nullopt;
+	}
+
+	return std::optional<Dictionary>(std::move(out));
+}
+
+bool Dictionary::save_snapshot(std::wstring& snapshot_filename, const FileStamp& source_stamp) const {
+	SnapshotHeader header{};
+	header.source_size = source_stamp.size;
+	header.source_mtime = source_stamp.mtime;
+
+	SnapshotWriter writer;
+	writer.write_pool_sizes(*pool);
+	writer.write_u32((uint32_t)akk_keys.size());
+
+	for (size_t i = 0; i < akk_keys.size(); i++) {
+		writer.write_key(akk_keys[i], entries(*pool, akk_offsets, i));
+	}
+
+	writer.write_array(akk_index.slot_positions());
+	writer.write_array(akk_index.slot_hashes());
+	writer.write_array(akk_folded.get_text());
+	writer.write_array(akk_folded.get_offsets());
+
+	writer.write_pool_sizes(engl->lines);
+	writer.write_u32((uint32_t)engl->line_words.size());
+
+	for (size_t i = 0; i < engl->line_words.size(); i++) {
+		writer.write_str(engl->line_words[i]);
+		writer.write_entry(engl->lines.entries[i]);
+	}
+
+	writer.write_u32((uint32_t)unresolved.size());
+
+	for (const UnresolvedRelation& rel : unresolved) {
+		writer.write_u32((uint32_t)rel.line);
+		writer.write_str(rel.word);
+		writer.write_u8((uint8_t)rel.kind);
+		writer.write_str(rel.target);
+	}
+
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC);
+	header.version = SNAPSHOT_VERSION;
+	header.char_size = sizeof(char);
+
+	const std::vector<unsigned char> payload = writer.payload();
+	header.payload_size = payload.size();
+	header.checksum = fnv1a(payload.data(), payload.size());
+
+	// Write to a temporary file first so that a reader never sees a partially written snapshot
+	std::wstring tmp_filename = snapshot_filename + L".tmp";
+	HANDLE file = CreateFileW(tmp_filename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	DWORD written;
+	bool success = WriteFile(file, &header, sizeof header, &written, nullptr) &&
+		WriteFile(file, payload.data(), (DWORD)payload.size(), &written, nullptr) &&
+		written == payload.size();
+
+	CloseHandle(file);
+
+	if (!success) {
+		return false;
+	}
+
+	return MoveFileExW(tmp_filename.c_str(), snapshot_filename.c_str(), MOVEFILE_REPLACE_EXISTING);
+}
@@ -0,0 +1,129 @@
+#include "suffix_array.h"
+#include <algorithm>
+
+void SuffixArray::build(std::span<const Symbol> keys) {
+	text.clear();
+	offsets.clear();
+	lengths.clear();
+	offsets.reserve(keys.size() + 1);
+	lengths.reserve(keys.size());
+
+	for (Symbol sym : keys) {
+		std::string_view word = Akk::symbols.str(sym);
+		uint32_t length = 0;
+
+		for (char c : word) {
+			if (((unsigned char)c & 0xC0) != 0x80) {
+				length++;
+			}
+		}
+
+		offsets.push_back((uint32_t)text.size());
+		lengths.push_back(length);
+		text += word;
+		text += END;
+	}
+
+	offsets.push_back((uint32_t)text.size());
+
+	// The suffixes are sorted by their first 8 bytes packed into an integer, with the bytes after the end of the
+	// key as zeros, and then only the runs that are the same in the first 8 bytes are compared as strings
+	std::vector<std::pair<uint64_t, uint32_t>> items(text.size());
+
+	for (uint32_t pos = 0; pos < (uint32_t)text.size(); pos++) {
+		uint64_t prefix = 0;
+		bool ended = false;
+
+		for (uint32_t i = pos; i < pos + PREFIX_SIZE; i++) {
+			ended = ended || i >= text.size() || text[i] == END;
+			prefix = (prefix << 8) | (ended ? 0 : (unsigned char)text[i]);
+		}
+
+		items[pos] = std::make_pair(prefix, pos);
+	}
+
+	std::sort(items.begin(), items.end());
+
+	for (size_t begin = 0; begin < items.size();) {
+		size_t end = begin + 1;
+
+		while (end < items.size() && items[end].first == items[begin].first) {
+			end++;
+		}
+
+		// If the last byte is zero, then every suffix in the run ended within the first 8 bytes and they're all the same
+		if (end - begin > 1 && (items[begin].first & 0xFF) != 0) {
+			std::sort(items.begin() + begin, items.begin() + end, [this](const std::pair<uint64_t, uint32_t>& lhs, const std::pair<uint64_t, uint32_t>& rhs) {
+				std::string_view lhs_suffix = suffix(lhs.second + PREFIX_SIZE);
+				std::string_view rhs_suffix = suffix(rhs.second + PREFIX_SIZE);
+
+				return lhs_suffix < rhs_suffix || (lhs_suffix == rhs_suffix && lhs.second < rhs.second);
+			});
+		}
+
+		begin = end;
+	}
+
+	// The key of every position in the text, so that find doesn't have to search the offsets for each match
+	std::vector<uint32_t> pos_keys(text.size());
+
+	for (uint32_t key = 0; key < (uint32_t)keys.size(); key++) {
+		std::fill(pos_keys.begin() + offsets[key], pos_keys.begin() + offsets[key + 1], key);
+	}
+
+	suffixes.resize(items.size());
+	suffix_keys.resize(items.size());
+
+	for (size_t i = 0; i < items.size(); i++) {
+		suffixes[i] = items[i].second;
+		suffix_keys[i] = pos_keys[items[i].second];
+	}
+}
+
+void SuffixArray::find(std::string_view query, size_t limit, std::vector<uint32_t>& out) const {
+	// No key contains the null char, and it would match across the end of a key
+	if (query.find(END) != std::string_view::npos) {
+		return;
+	}
+
+	// The suffixes that start with the query are a range
+	auto begin = std::partition_point(suffixes.begin(), suffixes.end(), [&](uint32_t pos) {
+		return suffix(pos).substr(0, query.size()) < query;
+	});
+	auto end = std::partition_point(begin, suffixes.end(), [&](uint32_t pos) {
+		return suffix(pos).substr(0, query.size()) == query;
+	});
+
+	// A key can contain the query more than once, so each key is only taken the first time it's seen. Only the
+	// unique keys are sorted.
+	const size_t num_keys = lengths.size();
+	std::vector<uint64_t> seen((num_keys + 63) / 64);
+	std::vector<uint32_t> found;
+
+	for (size_t i = begin - suffixes.begin(); i < (size_t)(end - suffixes.begin()); i++) {
+		const uint32_t key = suffix_keys[i];
+		const uint64_t bit = (uint64_t)1 << (key % 64);
+
+		if (!(seen[key / 64] & bit)) {
+			seen[key / 64] |= bit;
+			found.push_back(key);
+		}
+	}
+
+	const size_t count = (std::min)(limit, found.size());
+
+	std::partial_sort(found.begin(), found.begin() + count, found.end(), [this](uint32_t lhs, uint32_t rhs) {
+		return lengths[lhs] < lengths[rhs] || (lengths[lhs] == lengths[rhs] && lhs < rhs);
+	});
+
+	out.insert(out.end(), found.begin(), found.begin() + count);
+}
+
+/**
+ * Returns the text from 'pos' to the end of its key
+ */
+std::string_view SuffixArray::suffix(uint32_t pos) const {
+	std::string_view out = std::string_view(text).substr(pos);
+
+	return out.substr(0, out.find(END));
+}
@@ -0,0 +1,49 @@
+/**
+ * Index for finding the keys that contain a string.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "symbols.h"
+
+/**
+ * A suffix array over a list of keys. The keys are stored back to back, each one ended by a null char, and every
+ * position in that text is sorted by the rest of its key from there on. The keys that contain a query are the keys
+ * of one range of sorted positions, which is found with two binary searches, so nothing else is looked at.
+ *
+ * The index is built once and then only read, so it can be searched from any number of threads at once.
+ */
+typedef struct SuffixArray {
+	/**
+	 * Builds the index for a list of keys. Any previous contents are replaced.
+	 */
+	void build(std::span<const Symbol> keys);
+
+	/**
+	 * Finds the shortest 'limit' keys that contain 'query' and appends their positions to 'out', shortest first.
+	 * Length is counted in characters. Keys with the same length are in the order of their positions.
+	 */
+	void find(std::string_view query, size_t limit, std::vector<uint32_t>& out) const;
+
+private:
+	static const char END = '\0';
+	static const uint32_t PREFIX_SIZE = 8;
+
+	std::string text{};
+	// Key i is text[offsets[i], offsets[i + 1] - 1), followed by END
+	std::vector<uint32_t> offsets{};
+	// Length of each key in characters
+	std::vector<uint32_t> lengths{};
+	// Every position in 'text', sorted by the text from there to the end of its key
+	std::vector<uint32_t> suffixes{};
+	// The key that each position in 'suffixes' is in
+	std::vector<uint32_t> suffix_keys{};
+
+	std::string_view suffix(uint32_t pos) const;
+} SuffixArray;
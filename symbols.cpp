@@ -0,0 +1,103 @@
+#include "symbols.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <mutex>
+
+SymbolTable Akk::symbols;
+
+SymbolTable::~SymbolTable() {
+	for (std::atomic<std::string_view*>& segment : segments) {
+		delete[] segment.load();
+	}
+}
+
+Symbol SymbolTable::intern(std::string_view str) {
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		auto it = index.find(str);
+
+		if (it != index.end()) {
+			return it->second;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> lock(mutex);
+	auto it = index.find(str);
+
+	// Another thread could have added the string between the two locks
+	if (it != index.end()) {
+		return it->second;
+	}
+
+	const Symbol sym = count.load(std::memory_order_relaxed);
+	size_t segment;
+	size_t offset;
+	locate(sym, segment, offset);
+
+	std::string_view* views = segments[segment].load(std::memory_order_relaxed);
+
+	if (!views) {
+		views = new std::string_view[FIRST_SEGMENT_SIZE << segment];
+		segments[segment].store(views, std::memory_order_release);
+	}
+
+	std::string_view stored = store_text(str);
+	views[offset] = stored;
+	index.emplace(stored, sym);
+	count.store(sym + 1, std::memory_order_release);
+
+	return sym;
+}
+
+std::optional<Symbol> SymbolTable::find(std::string_view str) const {
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	auto it = index.find(str);
+
+	if (it == index.end()) {
+		return std::nullopt;
+	}
+
+	return std::optional<Symbol>(it->second);
+}
+
+std::string_view SymbolTable::str(Symbol sym) const {
+	size_t segment;
+	size_t offset;
+	locate(sym, segment, offset);
+
+	return segments[segment].load(std::memory_order_acquire)[offset];
+}
+
+bool SymbolTable::less(Symbol lhs, Symbol rhs) const {
+	return str(lhs) < str(rhs);
+}
+
+size_t SymbolTable::size() const {
+	return count.load(std::memory_order_acquire);
+}
+
+void SymbolTable::locate(Symbol sym, size_t& segment, size_t& offset) {
+	const size_t pos = (size_t)sym + FIRST_SEGMENT_SIZE;
+
+	segment = (size_t)(std::bit_width(pos) - std::bit_width(FIRST_SEGMENT_SIZE));
+	offset = pos - (FIRST_SEGMENT_SIZE << segment);
+}
+
+std::string_view SymbolTable::store_text(std::string_view str) {
+	if (str.size() > text_left) {
+		const size_t block_size = (std::max)(str.size(), TEXT_BLOCK_SIZE);
+
+		text_blocks.push_back(std::make_unique<char[]>(block_size));
+		text_pos = text_blocks.back().get();
+		text_left = block_size;
+	}
+
+	std::copy(str.begin(), str.end(), text_pos);
+
+	std::string_view out(text_pos, str.size());
+	text_pos += str.size();
+	text_left -= str.size();
+
+	return out;
+}
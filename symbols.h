@@ -0,0 +1,82 @@
+/**
+ * Interned strings. Every distinct word and definition in the dictionary is stored once in a global
+ * symbol table, and dictionary entries refer to strings by their 32-bit symbol. Comparing two symbols
+ * is the same as comparing the strings for equality. Strings are UTF-8.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t Symbol;
+
+/**
+ * An append-only table of strings. Strings are never removed, so a symbol stays valid for the life of the
+ * program, even across dictionary reloads. The table can be used from any thread. Getting the string for a
+ * symbol never takes a lock.
+ */
+typedef struct SymbolTable {
+	SymbolTable() = default;
+
+	SymbolTable(const SymbolTable&) = delete;
+	SymbolTable& operator=(const SymbolTable&) = delete;
+
+	~SymbolTable();
+
+	/**
+	 * Returns the symbol for a string, adding the string to the table if it isn't already there.
+	 */
+	Symbol intern(std::string_view str);
+
+	/**
+	 * Returns the symbol for a string if the string is in the table.
+	 */
+	std::optional<Symbol> find(std::string_view str) const;
+
+	/**
+	 * Returns the string for a symbol. The view is valid for the life of the table.
+	 */
+	std::string_view str(Symbol sym) const;
+
+	/**
+	 * Compares the strings for two symbols. Symbols are handed out in the order that strings are first
+	 * seen, which isn't the same from one run to the next, so anything that has to be sorted is sorted
+	 * by its text.
+	 */
+	bool less(Symbol lhs, Symbol rhs) const;
+
+	size_t size() const;
+
+private:
+	// Symbol views are stored in segments that double in size, so that a segment never has to move
+	// while another thread is reading from it
+	static const size_t FIRST_SEGMENT_SIZE = 1024;
+	static const size_t NUM_SEGMENTS = 22;
+	// The characters of the strings are stored in blocks of at least this many characters
+	static constexpr size_t TEXT_BLOCK_SIZE = 64 * 1024;
+
+	std::atomic<std::string_view*> segments[NUM_SEGMENTS]{};
+	std::atomic<uint32_t> count{};
+
+	mutable std::shared_mutex mutex{};
+	std::unordered_map<std::string_view, Symbol> index{};
+	std::vector<std::unique_ptr<char[]>> text_blocks{};
+	char* text_pos{};
+	size_t text_left{};
+
+	static void locate(Symbol sym, size_t& segment, size_t& offset);
+	std::string_view store_text(std::string_view str);
+} SymbolTable;
+
+namespace Akk {
+	extern SymbolTable symbols;
+}
@@ -0,0 +1,69 @@
+/**
+ * Synthetic dictionaries for the benchmarks in this directory. Larger dictionaries are made by copying a real one
+ * and renaming the Akkadian words of each copy, so that they have the same mix of words and lengths.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "../dict.h"
+
+/**
+ * Returns 'copies' copies of the dictionary text. The Akkadian word of copy i > 0 gets the suffix "_i".
+ */
+inline std::string copy_dict(std::string_view text, size_t copies) {
+	std::vector<std::string_view> lines = split_dict_lines(text);
+	std::string out;
+
+	for (size_t i = 0; i < copies; i++) {
+		const std::string suffix = i == 0 ? "" : "_" + std::to_string(i);
+
+		for (std::string_view line : lines) {
+			const size_t comma = (std::min)(line.find(','), line.size());
+
+			out.append(line.substr(0, comma));
+			out.append(suffix);
+			out.append(line.substr(comma));
+			out.push_back('\n');
+		}
+	}
+
+	return out;
+}
+
+/**
+ * Returns the Akkadian words of the dictionary text, each one once, in the order they first appear
+ */
+inline std::vector<std::string_view> akk_words(std::string_view text) {
+	std::unordered_set<std::string_view> seen;
+	std::vector<std::string_view> out;
+
+	for (std::string_view line : split_dict_lines(text)) {
+		std::string_view word = line.substr(0, (std::min)(line.find(','), line.size()));
+
+		if (seen.insert(word).second) {
+			out.push_back(word);
+		}
+	}
+
+	return out;
+}
+
+/**
+ * Returns the number of copies of the dictionary text that copy_dict needs to make for at least 'keys' Akkadian
+ * keys. Every copy has the same number of keys as the original.
+ */
+inline size_t copies_for_keys(std::string_view text, size_t keys) {
+	const size_t keys_per_copy = akk_words(text).size();
+
+	if (keys_per_copy == 0) {
+		return 1;
+	}
+
+	return (std::max)((size_t)1, (keys + keys_per_copy - 1) / keys_per_copy);
+}
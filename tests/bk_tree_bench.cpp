@@ -0,0 +1,155 @@
+/**
+ * Benchmark for the BK-tree against a brute-force scan. This is a console program with no Win32 UI; build it with
+ * the dictionary sources (everything but AkkadianWords.cpp, handlers.cpp, and components.cpp).
+ *
+ *		bk_tree_bench [dict file] [radius] [queries]
+ *
+ * The file is copied into lexicons of 10k, 100k, and 1M Akkadian keys (see bench_dict.h), and the keys are folded
+ * the same way as for the fuzzy search. Queries are random keys with 0-3 random edits. For each lexicon, this
+ * prints the time to build the tree, and the mean time per query to find every key within 'radius' (4 by
+ * default) with the tree and by comparing the query to every key. It checks that the tree finds exactly the same
+ * keys as the scan.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#include "../common.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../bk_tree.h"
+#include "../dict.h"
+#include "../edit_distance.h"
+#include "../errors.h"
+#include "../letters.h"
+#include "bench_dict.h"
+
+const size_t LEXICON_SIZES[] = { 10000, 100000, 1000000 };
+const int MAX_EDITS = 3;
+
+/**
+ * Returns the time since 'start' in milliseconds
+ */
+static double ms_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Returns a random key with up to MAX_EDITS random substitutions, insertions, and deletions
+ */
+static std::u32string random_query(const FoldedKeys& keys, std::mt19937& rng) {
+	std::u32string out(keys[rng() % keys.size()]);
+	const int edits = (int)(rng() % (MAX_EDITS + 1));
+
+	for (int i = 0; i < edits; i++) {
+		const char32_t c = U'a' + (char32_t)(rng() % 26);
+		const size_t pos = rng() % (out.size() + 1);
+
+		switch (rng() % 3) {
+		case 0:
+			if (pos < out.size()) {
+				out[pos] = c;
+			}
+			break;
+		case 1:
+			out.insert(out.begin() + pos, c);
+			break;
+		default:
+			if (pos < out.size()) {
+				out.erase(out.begin() + pos);
+			}
+			break;
+		}
+	}
+
+	return out;
+}
+
+int main(int argc, char** argv) {
+	std::wstring filename = std::filesystem::path(argc > 1 ? argv[1] : "dict.dat").wstring();
+	const int radius = argc > 2 ? std::stoi(argv[2]) : 4;
+	const size_t num_queries = argc > 3 ? std::stoul(argv[3]) : 200;
+	std::string text;
+
+	try {
+		text = read_dict_file(filename);
+	} catch (DictParseError err) {
+		std::wcout << err.message() << std::endl;
+		return 1;
+	}
+
+	bool same = true;
+
+	std::cout << "radius " << radius << ", " << num_queries << " queries" << std::endl;
+	std::cout << "keys\tbuild ms\ttree ms\tscan ms\tspeedup\tmatches per query" << std::endl;
+
+	for (size_t lexicon_size : LEXICON_SIZES) {
+		const std::string big_text = copy_dict(text, copies_for_keys(text, lexicon_size));
+		std::vector<Symbol> symbols;
+
+		for (std::string_view word : akk_words(big_text)) {
+			symbols.push_back(Akk::symbols.intern(word));
+		}
+
+		FoldedKeys keys;
+		BKTree tree;
+
+		keys.build(symbols);
+
+		const auto build_start = std::chrono::steady_clock::now();
+		tree.build(keys);
+		const double build_ms = ms_since(build_start);
+
+		std::mt19937 rng(1);
+		std::vector<std::u32string> queries;
+
+		for (size_t i = 0; i < num_queries; i++) {
+			queries.push_back(random_query(keys, rng));
+		}
+
+		std::vector<std::vector<uint32_t>> tree_matches(queries.size());
+		std::vector<std::vector<uint32_t>> scan_matches(queries.size());
+		size_t cells = 0;
+		size_t num_matches = 0;
+
+		const auto tree_start = std::chrono::steady_clock::now();
+
+		for (size_t i = 0; i < queries.size(); i++) {
+			tree.find(queries[i], radius, tree_matches[i], cells);
+		}
+
+		const double tree_ms = ms_since(tree_start) / queries.size();
+		const auto scan_start = std::chrono::steady_clock::now();
+
+		for (size_t i = 0; i < queries.size(); i++) {
+			const LevPattern pattern(queries[i]);
+
+			for (uint32_t pos = 0; pos < keys.size(); pos++) {
+				if (pattern.distance_within(keys[pos], radius, cells) <= radius) {
+					scan_matches[i].push_back(pos);
+				}
+			}
+		}
+
+		const double scan_ms = ms_since(scan_start) / queries.size();
+
+		for (size_t i = 0; i < queries.size(); i++) {
+			std::sort(tree_matches[i].begin(), tree_matches[i].end());
+			same &= tree_matches[i] == scan_matches[i];
+			num_matches += scan_matches[i].size();
+		}
+
+		std::cout << keys.size() << "\t" << build_ms << "\t" << tree_ms << "\t" << scan_ms << "\t" << scan_ms / tree_ms
+			<< "\t" << (double)num_matches / queries.size() << std::endl;
+	}
+
+	if (!same) {
+		std::cout << "The tree found different keys than the scan" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
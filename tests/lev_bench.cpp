@@ -0,0 +1,139 @@
+/**
+ * Microbenchmark for the Levenshtein distance kernels in edit_distance.h. This is a console program with no Win32
+ * UI; build it with the dictionary sources (everything but AkkadianWords.cpp, handlers.cpp, and components.cpp).
+ *
+ *		lev_bench [dict file] [keys] [cutoff]
+ *
+ * The file is copied until there are at least 'keys' Akkadian keys (20k by default, see bench_dict.h), and the
+ * keys are folded the same way as for the fuzzy search. Queries are random keys with the first letter changed
+ * and one added. Every query is compared to every key with each kernel, and this prints the time per pair in
+ * nanoseconds:
+ *
+ *		lev_distance					the plain DP
+ *		LevPattern::distance			Myers' bit-parallel algorithm
+ *		lev_distance_within				the banded DP, bounded by 'cutoff' (4 by default)
+ *		LevPattern::distance_within		Myers' algorithm, bounded by 'cutoff'
+ *
+ * It also checks that all of the kernels agree.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#include "../common.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../dict.h"
+#include "../edit_distance.h"
+#include "../errors.h"
+#include "../letters.h"
+#include "bench_dict.h"
+
+const size_t NUM_QUERIES = 50;
+
+/**
+ * Computes the distance from every query to every key and returns the time per pair in nanoseconds. The
+ * distances are stored in 'dists', one row per query.
+ */
+template <typename F>
+static double ns_per_pair(
+	const std::vector<std::u32string>& queries,
+	const std::vector<std::u32string>& keys,
+	std::vector<int>& dists,
+	F distance
+) {
+	dists.assign(queries.size() * keys.size(), 0);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < queries.size(); i++) {
+		for (size_t j = 0; j < keys.size(); j++) {
+			dists[i * keys.size() + j] = distance(i, keys[j]);
+		}
+	}
+
+	const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	return ns / dists.size();
+}
+
+int main(int argc, char** argv) {
+	std::wstring filename = std::filesystem::path(argc > 1 ? argv[1] : "dict.dat").wstring();
+	const size_t num_keys = argc > 2 ? std::stoul(argv[2]) : 20000;
+	const int cutoff = argc > 3 ? std::stoi(argv[3]) : 4;
+	std::string text;
+
+	try {
+		text = read_dict_file(filename);
+	} catch (DictParseError err) {
+		std::wcout << err.message() << std::endl;
+		return 1;
+	}
+
+	const std::string big_text = copy_dict(text, copies_for_keys(text, num_keys));
+	std::vector<std::u32string> keys;
+
+	for (std::string_view word : akk_words(big_text)) {
+		keys.push_back(fold_word(word));
+	}
+
+	std::mt19937 rng(1);
+	std::vector<std::u32string> queries;
+
+	for (size_t i = 0; i < NUM_QUERIES; i++) {
+		std::u32string query = keys[rng() % keys.size()];
+
+		if (!query.empty()) {
+			query[0] = query[0] == U'a' ? U'e' : U'a';
+		}
+
+		queries.push_back(query + U'a');
+	}
+
+	std::vector<LevPattern> patterns;
+
+	for (const std::u32string& query : queries) {
+		patterns.push_back(LevPattern(query));
+	}
+
+	std::vector<int> plain;
+	std::vector<int> myers;
+	std::vector<int> banded;
+	std::vector<int> myers_banded;
+	size_t banded_cells = 0;
+	size_t myers_cells = 0;
+
+	std::cout << keys.size() << " keys, " << queries.size() << " queries, cutoff " << cutoff << std::endl;
+
+	std::cout << "lev_distance\t\t\t" << ns_per_pair(queries, keys, plain, [&](size_t i, std::u32string_view key) {
+		return lev_distance(queries[i], key);
+	}) << " ns" << std::endl;
+
+	std::cout << "LevPattern::distance\t\t" << ns_per_pair(queries, keys, myers, [&](size_t i, std::u32string_view key) {
+		return patterns[i].distance(key);
+	}) << " ns" << std::endl;
+
+	std::cout << "lev_distance_within\t\t" << ns_per_pair(queries, keys, banded, [&](size_t i, std::u32string_view key) {
+		return lev_distance_within(queries[i], key, cutoff, banded_cells);
+	}) << " ns\t" << banded_cells << " cells" << std::endl;
+
+	std::cout << "LevPattern::distance_within\t" << ns_per_pair(queries, keys, myers_banded, [&](size_t i, std::u32string_view key) {
+		return patterns[i].distance_within(key, cutoff, myers_cells);
+	}) << " ns\t" << myers_cells << " cells" << std::endl;
+
+	bool same = plain == myers && banded == myers_banded;
+
+	for (size_t i = 0; i < plain.size(); i++) {
+		same &= (std::min)(plain[i], cutoff + 1) == banded[i];
+	}
+
+	if (!same) {
+		std::cout << "The kernels gave different distances" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * Benchmark for parsing the dictionary file in chunks on the thread pool. This is a console program with no Win32
+ * UI; build it with the dictionary sources (everything but AkkadianWords.cpp, handlers.cpp, and components.cpp).
+ *
+ *		parse_bench [dict file] [max copies]
+ *
+ * The file is copied into texts of 1, 2, 4, ... copies, up to 'max copies'. Each copy after the first adds a
+ * suffix to its Akkadian words so that they're all different. For each size, this prints the time to parse
+ * every line on one thread and the time for parse_dict_text. parse_dict_text only splits a file into chunks
+ * once it's 128 KB or more, so the sizes around that show whether the threshold is in the right place.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#include "../common.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../dict.h"
+#include "../errors.h"
+#include "../thread_pool.h"
+#include "bench_dict.h"
+
+const int RUNS = 5;
+
+/**
+ * Returns the best time of a few runs in milliseconds
+ */
+template <typename F>
+static double best_ms(F run) {
+	double best = 0;
+
+	for (int i = 0; i < RUNS; i++) {
+		const auto start = std::chrono::steady_clock::now();
+		run();
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		best = i == 0 ? ms : (std::min)(best, ms);
+	}
+
+	return best;
+}
+
+int main(int argc, char** argv) {
+	std::wstring filename = std::filesystem::path(argc > 1 ? argv[1] : "dict.dat").wstring();
+	const size_t max_copies = argc > 2 ? std::stoul(argv[2]) : 64;
+	std::string text;
+
+	try {
+		text = read_dict_file(filename);
+	} catch (DictParseError err) {
+		std::wcout << err.message() << std::endl;
+		return 1;
+	}
+
+	std::cout << "cores " << std::thread::hardware_concurrency() << ", pool threads " << ThreadPool::shared().size()
+		<< std::endl;
+	std::cout << "copies\tKB\tlines\tone thread ms\tparse_dict_text ms\tspeedup" << std::endl;
+
+	for (size_t copies = 1; copies <= max_copies; copies *= 2) {
+		const std::string big_text = copy_dict(text, copies);
+		size_t num_lines = 0;
+
+		const double serial = best_ms([&]() {
+			std::vector<ParsedLine> parsed;
+			std::vector<std::string_view> lines = split_dict_lines(big_text);
+
+			for (size_t i = 0; i < lines.size(); i++) {
+				parsed.push_back(parse_dict_line(lines[i], (int)i + 1));
+			}
+
+			num_lines = parsed.size();
+		});
+
+		const double chunked = best_ms([&]() {
+			if (parse_dict_text(big_text).size() != num_lines) {
+				std::cout << "parse_dict_text returned the wrong number of lines" << std::endl;
+				std::exit(1);
+			}
+		});
+
+		std::cout << copies << "\t" << big_text.size() / 1024 << "\t" << num_lines << "\t" << serial << "\t" << chunked
+			<< "\t" << serial / chunked << std::endl;
+	}
+
+	return 0;
+}
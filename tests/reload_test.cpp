@@ -0,0 +1,83 @@
+﻿/**
+ * Checks that a reload rejects the same files as a fresh load. This is a console program with no Win32 UI;
+ * build it with the dictionary sources (everything but AkkadianWords.cpp, handlers.cpp, and components.cpp)
+ * and run it from any directory. It returns nonzero if a check fails.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#include "../common.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "../errors.h"
+#include "../reload.h"
+
+static void write_file(const std::filesystem::path& path, const std::string& text) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out << text;
+}
+
+/**
+ * Returns the line of the error from a fresh load of the file, or -1 if it loads
+ */
+static int fresh_load_error(std::wstring& filename) {
+	try {
+		parse_dict_text(read_dict_file(filename));
+	} catch (DictParseError err) {
+		return err.line;
+	}
+
+	return -1;
+}
+
+/**
+ * Returns the line of the error from reloading the file, or -1 if it reloads
+ */
+static int reload_error(DictSource& source, std::wstring& filename) {
+	std::vector<ParsedLine> removed;
+	size_t added_begin = 0;
+	size_t added_end = 0;
+
+	try {
+		source.update(filename, removed, added_begin, added_end);
+	} catch (DictParseError err) {
+		return err.line;
+	}
+
+	return -1;
+}
+
+static bool appended_blank_line() {
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "reload_test_dict.dat";
+	std::wstring filename = path.wstring();
+	const std::string text = "šarrum,king,n\nbītum,house,n\n";
+
+	write_file(path, text);
+	DictSource source(filename);
+
+	write_file(path, text + "\n");
+	const int fresh_line = fresh_load_error(filename);
+	const int reload_line = reload_error(source, filename);
+	const size_t num_parsed = source.get_parsed().size();
+
+	std::filesystem::remove(path);
+
+	if (fresh_line != 3 || reload_line != fresh_line || num_parsed != 2) {
+		std::cout << "appended blank line: fresh load error on line " << fresh_line << ", reload error on line "
+			<< reload_line << ", " << num_parsed << " lines kept" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int main() {
+	bool passed = true;
+
+	passed &= appended_blank_line();
+
+	std::cout << (passed ? "All reload tests passed" : "Some reload tests failed") << std::endl;
+
+	return passed ? 0 : 1;
+}
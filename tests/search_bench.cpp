@@ -0,0 +1,124 @@
+/**
+ * Benchmark for the sharded fuzzy search. This is a console program with no Win32 UI; build it with the dictionary
+ * sources (everything but AkkadianWords.cpp, handlers.cpp, and components.cpp).
+ *
+ *		search_bench [dict file] [keys] [cutoff]
+ *
+ * The file is copied until there are at least 'keys' Akkadian keys (1M by default), and each copy after the first
+ * adds a suffix to its Akkadian words so that they're all different (see bench_dict.h). Queries are random keys
+ * with the first letter changed and one added, so that they take the fuzzy search. For each fuzzy index, this
+ * prints the mean time per query with no pool and with pools of 1, 2, 4, ... threads up to the number of cores
+ * (at least 8), and checks that every pool gives the same results as no pool.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#include "../common.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../dict.h"
+#include "../errors.h"
+#include "../thread_pool.h"
+#include "bench_dict.h"
+
+const size_t NUM_QUERIES = 200;
+const size_t LIMIT = 15;
+
+/**
+ * Searches for every query and returns the mean time per query in milliseconds
+ */
+static double mean_ms(
+	const Dictionary& dict,
+	const std::vector<std::string>& queries,
+	int cutoff,
+	FuzzyIndex fuzzy_index,
+	ThreadPool* pool,
+	std::vector<std::vector<std::string>>& results
+) {
+	results.clear();
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (const std::string& query : queries) {
+		results.push_back(dict.search(query, LIMIT, cutoff, false, fuzzy_index, nullptr, pool));
+	}
+
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	return ms / queries.size();
+}
+
+int main(int argc, char** argv) {
+	std::wstring filename = std::filesystem::path(argc > 1 ? argv[1] : "dict.dat").wstring();
+	const size_t keys = argc > 2 ? std::stoul(argv[2]) : 1000000;
+	const int cutoff = argc > 3 ? std::stoi(argv[3]) : 4;
+	std::shared_ptr<const Dictionary> dict;
+	size_t copies = 0;
+
+	try {
+		const std::string text = read_dict_file(filename);
+
+		copies = copies_for_keys(text, keys);
+		dict = std::make_shared<const Dictionary>(parse_dict_text(copy_dict(text, copies)));
+	} catch (DictParseError err) {
+		std::wcout << err.message() << std::endl;
+		return 1;
+	}
+
+	std::mt19937 rng(1);
+	std::vector<std::string> queries;
+
+	for (size_t i = 0; i < NUM_QUERIES; i++) {
+		std::string query = dict->random_akk(rng).first;
+
+		// The first letter can take more than one byte
+		size_t first_size = 1;
+
+		while (first_size < query.size() && ((unsigned char)query[first_size] & 0xC0) == 0x80) {
+			first_size++;
+		}
+
+		query.replace(0, first_size, query[0] == 'a' ? "e" : "a");
+		queries.push_back(query + "a");
+	}
+
+	const size_t max_threads = (std::max)((size_t)8, (size_t)std::thread::hardware_concurrency());
+	bool same = true;
+
+	std::cout << "cores " << std::thread::hardware_concurrency() << ", cutoff " << cutoff << ", " << copies
+		<< " copies (at least " << keys << " keys)" << std::endl;
+
+	for (FuzzyIndex fuzzy_index : { MetricTree, Automaton }) {
+		std::vector<std::vector<std::string>> serial_results;
+		std::vector<std::vector<std::string>> results;
+
+		// The indexes are built the first time they're used
+		dict->search(queries[0], LIMIT, cutoff, false, fuzzy_index);
+
+		std::cout << (fuzzy_index == MetricTree ? "tree" : "graph") << "\tno pool "
+			<< mean_ms(*dict, queries, cutoff, fuzzy_index, nullptr, serial_results) << " ms";
+
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			ThreadPool pool(threads);
+
+			std::cout << "\t" << threads << " threads " << mean_ms(*dict, queries, cutoff, fuzzy_index, &pool, results)
+				<< " ms";
+			same &= results == serial_results;
+		}
+
+		std::cout << std::endl;
+	}
+
+	if (!same) {
+		std::cout << "A pool gave different results than no pool" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t num_threads) {
+	if (num_threads == 0) {
+		num_threads = std::thread::hardware_concurrency();
+	}
+
+	if (num_threads == 0) {
+		num_threads = 1;
+	}
+
+	for (size_t i = 0; i < num_threads; i++) {
+		workers.push_back(std::thread(&ThreadPool::work, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	cv.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::for_each(size_t count, std::function<void(size_t)> task) {
+	if (count == 0) {
+		return;
+	}
+
+	std::shared_ptr<ForEach> state = std::make_shared<ForEach>();
+	state->task = std::move(task);
+	state->count = count;
+
+	const size_t num_helpers = (std::min)(workers.size(), count - 1);
+
+	for (size_t i = 0; i < num_helpers; i++) {
+		enqueue([state]() { run_for_each(*state); });
+	}
+
+	run_for_each(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->cv.wait(lock, [&]() { return state->done == state->count; });
+
+	if (state->err) {
+		std::rethrow_exception(state->err);
+	}
+}
+
+size_t ThreadPool::size() const {
+	return workers.size();
+}
+
+ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool(0);
+
+	return pool;
+}
+
+void ThreadPool::run_for_each(ForEach& state) {
+	for (size_t i = state.next++; i < state.count; i = state.next++) {
+		std::exception_ptr err{};
+
+		try {
+			state.task(i);
+		} catch (...) {
+			err = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(state.mutex);
+
+		if (err && !state.err) {
+			state.err = err;
+		}
+
+		if (++state.done == state.count) {
+			state.cv.notify_all();
+		}
+	}
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+
+	cv.notify_one();
+}
+
+void ThreadPool::work() {
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
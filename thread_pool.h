@@ -0,0 +1,89 @@
+/**
+ * A fixed-size pool of worker threads for splitting expensive work (like loading a large dictionary)
+ * across cores.
+ *
+ * Author: Joe Desmond - dezzmeister16@gmail.com
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+typedef struct ThreadPool {
+	/**
+	 * Starts 'num_threads' worker threads. If 'num_threads' is zero, one thread is started for each core.
+	 */
+	ThreadPool(size_t num_threads);
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * Finishes all queued tasks and then stops the workers.
+	 */
+	~ThreadPool();
+
+	/**
+	 * Queues a task and returns a future for its result. If the task throws, the exception is
+	 * rethrown by the future.
+	 */
+	template <typename F>
+	std::future<std::invoke_result_t<F>> submit(F task) {
+		typedef std::invoke_result_t<F> R;
+
+		std::shared_ptr<std::packaged_task<R()>> packaged = std::make_shared<std::packaged_task<R()>>(std::move(task));
+		std::future<R> out = packaged->get_future();
+
+		enqueue([packaged]() { (*packaged)(); });
+
+		return out;
+	}
+
+	/**
+	 * Calls task(i) for each i in [0, count) and returns when all of them are done. The calling thread and up to
+	 * size() workers each take the next i that hasn't been taken yet until there are none left, so a thread that
+	 * gets quick tasks takes more of them. If any task throws, the first exception is rethrown once every task
+	 * is done.
+	 */
+	void for_each(size_t count, std::function<void(size_t)> task);
+
+	size_t size() const;
+
+	/**
+	 * A pool shared by the whole application with one thread per core. It's created the first time it's used.
+	 */
+	static ThreadPool& shared();
+
+private:
+	std::vector<std::thread> workers{};
+	std::deque<std::function<void()>> tasks{};
+	std::mutex mutex{};
+	std::condition_variable cv{};
+	bool stopping{};
+
+	// The tasks of a call to for_each. Workers that start after the last task was taken return right away, so
+	// this is shared with them instead of living on the caller's stack.
+	typedef struct ForEach {
+		std::function<void(size_t)> task{};
+		size_t count{};
+		std::atomic<size_t> next{};
+		std::mutex mutex{};
+		std::condition_variable cv{};
+		size_t done{};
+		std::exception_ptr err{};
+	} ForEach;
+
+	static void run_for_each(ForEach& state);
+
+	void enqueue(std::function<void()> task);
+	void work();
+} ThreadPool;